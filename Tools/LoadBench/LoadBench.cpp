@@ -0,0 +1,631 @@
+// Headless texture loading benchmark: runs the loader pipeline over an image directory without a window and prints JSON
+// Usage: LoadBench [image directory] [--threads 1,2,4] [--limit N] [--decode-only] [--cache] [--device name] [--output file.json]
+// Default directory is Textures/3000 (run from Vulkan/ like the app), default threads 1, 2, 4 ... up to the hardware threads
+// Per image on the workers: read (map the file and fault it in), then DecodeTexture like AnimationLoader's workers (decode, convert, hash)
+// With Vulkan on the main thread through the renderer's TextureUploader: image (create + bind memory),
+// staging (layer and mips into the ring + record), descriptor (view + set), then one wait for the GPU at the end of the run
+// Worker stage times are summed over threads, so with N threads they add up to about N times the wall time
+// Any Vulkan ICD works, e.g. lavapipe (VK_ICD_FILENAMES=.../lvp_icd.x86_64.json, --device llvmpipe)
+// Built without glfw3/Vulkan only the decode-only mode exists
+// Runs decode cold unless --cache, which goes through the texture cache (TEXTURE_CACHE_DIRECTORY) like the app
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "FastPng.h"
+#include "LoaderSettings.h"
+#include "MappedFile.h"
+#include "TextureDecode.h"
+#include "WorkQueue.h"
+
+#ifdef LOADBENCH_VULKAN
+#include "DeviceAllocator.h"
+#include "TextureUploader.h"
+#include "UploadBatch.h"
+#endif
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double Milliseconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static double PeakRssMB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1024.0 / 1024.0;
+#else
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0; // KB on Linux
+#endif
+}
+
+static std::string JsonString(const std::string& value)
+{
+    std::string result = "\"";
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if (static_cast<unsigned char>(c) < 0x20)
+            continue;
+        result += c;
+    }
+    return result + "\"";
+}
+
+struct StageTimes
+{
+    double read = 0.0;
+    double decode = 0.0;
+    double convert = 0.0;
+    double hash = 0.0;
+    double image = 0.0;
+    double staging = 0.0;
+    double descriptor = 0.0;
+    double gpuWait = 0.0;
+};
+
+struct DecodedImage
+{
+    size_t index = 0;
+    uint8_t* pixels = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+struct RunResult
+{
+    size_t threads = 0;
+    size_t images = 0;
+    size_t failed = 0;
+    uint64_t decodedBytes = 0;
+    double wallMs = 0.0;
+    StageTimes stages;
+};
+
+static void DecodeWorker(const std::vector<std::string>& images, bool cached, std::atomic<size_t>& next, WorkQueue<DecodedImage>& decoded, StageTimes& times)
+{
+    DecodeStageTimes decodeTimes;
+    for (size_t it = next++; it < images.size(); it = next++)
+    {
+        DecodedImage image;
+        image.index = it;
+
+        auto start = Clock::now();
+        {
+            MappedFile file;
+            volatile uint8_t touched = 0;
+            if (file.Open(images[it]))
+            {
+                // Mapping is lazy, fault every page in here so the disk/page cache part isn't counted as decoding
+                for (size_t offset = 0; offset < file.Size(); offset += 4096)
+                    touched = touched + file.Data()[offset];
+            }
+        }
+        times.read += Milliseconds(start, Clock::now());
+
+        DecodedTexture texture;
+        if (DecodeTexture(images[it], cached, nullptr, 0, 0, &texture, &decodeTimes))
+        {
+            image.pixels = texture.pixels;
+            image.width = texture.width;
+            image.height = texture.height;
+        }
+
+        decoded.Push(image);
+    }
+
+    times.decode += decodeTimes.decode;
+    times.convert += decodeTimes.convert;
+    times.hash += decodeTimes.hash;
+}
+
+#ifdef LOADBENCH_VULKAN
+// Just enough Vulkan for the upload path: no surface, one graphics queue (barriers and blits), the app's allocator, upload batch and texture uploader
+class HeadlessVulkan
+{
+public:
+    explicit HeadlessVulkan(const std::string& deviceFilter)
+    {
+        VkApplicationInfo appInfo = {};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "LoadBench";
+        appInfo.apiVersion = VK_API_VERSION_1_0;
+
+        VkInstanceCreateInfo instanceInfo = {};
+        instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instanceInfo.pApplicationInfo = &appInfo;
+        if (vkCreateInstance(&instanceInfo, nullptr, &m_instance) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create a Vulkan instance");
+
+        uint32_t deviceCount = 0;
+        vkEnumeratePhysicalDevices(m_instance, &deviceCount, nullptr);
+        std::vector<VkPhysicalDevice> devices(deviceCount);
+        vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
+
+        for (VkPhysicalDevice device : devices)
+        {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(device, &properties);
+            if (!deviceFilter.empty() && std::string(properties.deviceName).find(deviceFilter) == std::string::npos)
+                continue;
+
+            uint32_t familyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+            std::vector<VkQueueFamilyProperties> families(familyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, families.data());
+            for (uint32_t family = 0; family < familyCount; family++)
+            {
+                if (families[family].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+                {
+                    m_physicalDevice = device;
+                    m_queueFamily = family;
+                    m_deviceName = properties.deviceName;
+                    break;
+                }
+            }
+            if (m_physicalDevice != VK_NULL_HANDLE)
+                break;
+        }
+        if (m_physicalDevice == VK_NULL_HANDLE)
+            throw std::runtime_error("No Vulkan device with a graphics queue" + (deviceFilter.empty() ? std::string() : " matching " + deviceFilter));
+
+        float priority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo = {};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = m_queueFamily;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &priority;
+
+        VkDeviceCreateInfo deviceInfo = {};
+        deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceInfo.queueCreateInfoCount = 1;
+        deviceInfo.pQueueCreateInfos = &queueInfo;
+        if (vkCreateDevice(m_physicalDevice, &deviceInfo, nullptr, &m_device) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create a logical device");
+        vkGetDeviceQueue(m_device, m_queueFamily, 0, &m_queue);
+
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = m_queueFamily;
+        if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create a command pool");
+
+        VkSamplerCreateInfo samplerInfo = {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        if (vkCreateSampler(m_device, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create a sampler");
+
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &binding;
+        if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_setLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create a descriptor set layout");
+
+        m_allocator = std::make_unique<DeviceAllocator>(m_physicalDevice, m_device);
+        m_batch = std::make_unique<UploadBatch>(m_physicalDevice, m_device, m_queue, m_commandPool);
+        // Files are RGBA8, BC support never matters here
+        m_uploader = std::make_unique<TextureUploader>(m_physicalDevice, m_device, *m_allocator, *m_batch, false);
+    }
+
+    ~HeadlessVulkan()
+    {
+        DestroyTextures();
+        m_uploader.reset();
+        m_batch.reset();
+        m_allocator.reset();
+        vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+        vkDestroySampler(m_device, m_sampler, nullptr);
+        vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+        vkDestroyDevice(m_device, nullptr);
+        vkDestroyInstance(m_instance, nullptr);
+    }
+
+    const std::string& GetDeviceName() const { return m_deviceName; }
+    bool GetBlitMipmaps() const { return m_uploader->GetBlitMipmaps(); }
+
+    void BeginRun(size_t imageCount)
+    {
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = static_cast<uint32_t>(std::max<size_t>(imageCount, 1));
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = poolSize.descriptorCount;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create a descriptor pool");
+
+        m_batch->Begin();
+    }
+
+    // What CreateTextureImage does for one file, the descriptor part is the renderer's non-bindless set
+    void Upload(const DecodedImage& image, StageTimes& times)
+    {
+        TextureInfo info = m_uploader->MakeInfo(image.width, image.height, 1, TexturePackFormat::RGBA8, 1);
+
+        auto start = Clock::now();
+        Texture texture;
+        texture.image = m_uploader->CreateImage(info, &texture.memory);
+        auto end = Clock::now();
+        times.image += Milliseconds(start, end);
+
+        start = end;
+        m_batch->EnqueueImageTransition(texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, info.mipLevels);
+        m_uploader->EnqueueLayer(texture.image, info, 0, image.pixels);
+        m_uploader->EnqueueFinish(texture.image, info);
+        end = Clock::now();
+        times.staging += Milliseconds(start, end);
+
+        start = end;
+        texture.view = m_uploader->CreateView(texture.image, info);
+
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = m_descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &m_setLayout;
+        VkDescriptorSet descriptorSet;
+        if (vkAllocateDescriptorSets(m_device, &setInfo, &descriptorSet) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate a texture descriptor set");
+
+        VkDescriptorImageInfo descriptorImage = {};
+        descriptorImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        descriptorImage.imageView = texture.view;
+        descriptorImage.sampler = m_sampler;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = descriptorSet;
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.descriptorCount = 1;
+        write.pImageInfo = &descriptorImage;
+        vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+        end = Clock::now();
+        times.descriptor += Milliseconds(start, end);
+
+        m_textures.push_back(texture);
+    }
+
+    // Submits what is left and waits for every copy/blit of the run
+    void EndRun(StageTimes& times)
+    {
+        auto start = Clock::now();
+        m_batch->End();
+        m_batch->Flush();
+        times.gpuWait += Milliseconds(start, Clock::now());
+
+        DestroyTextures();
+    }
+
+private:
+    struct Texture
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        DeviceAllocation memory;
+    };
+
+    VkInstance m_instance = VK_NULL_HANDLE;
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    uint32_t m_queueFamily = 0;
+    VkCommandPool m_commandPool = VK_NULL_HANDLE;
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    std::string m_deviceName;
+
+    std::unique_ptr<DeviceAllocator> m_allocator;
+    std::unique_ptr<UploadBatch> m_batch;
+    std::unique_ptr<TextureUploader> m_uploader;
+    std::vector<Texture> m_textures;
+
+    void DestroyTextures()
+    {
+        if (m_device == VK_NULL_HANDLE)
+            return;
+        vkDeviceWaitIdle(m_device);
+        for (auto& texture : m_textures)
+        {
+            vkDestroyImageView(m_device, texture.view, nullptr);
+            m_allocator->DestroyImage(texture.image, texture.memory);
+        }
+        m_textures.clear();
+
+        if (m_descriptorPool != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+            m_descriptorPool = VK_NULL_HANDLE;
+        }
+    }
+};
+#else
+// Stand in so the run loop reads the same with and without Vulkan
+class HeadlessVulkan
+{
+public:
+    void BeginRun(size_t) {}
+    void Upload(const DecodedImage&, StageTimes&) {}
+    void EndRun(StageTimes&) {}
+};
+#endif
+
+static RunResult Run(const std::vector<std::string>& images, size_t threadCount, bool cached, HeadlessVulkan* vulkan)
+{
+    RunResult result;
+    result.threads = threadCount;
+    result.images = images.size();
+
+    auto start = Clock::now();
+    if (vulkan)
+        vulkan->BeginRun(images.size());
+
+    WorkQueue<DecodedImage> decoded(DECODE_QUEUE_CAPACITY);
+    std::atomic<size_t> next = 0;
+    std::vector<StageTimes> workerTimes(threadCount);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < threadCount; thread++)
+        threads.emplace_back(DecodeWorker, std::cref(images), cached, std::ref(next), std::ref(decoded), std::ref(workerTimes[thread]));
+
+    // Keep draining after an upload error so no worker stays blocked on a full queue
+    std::string firstError;
+    for (size_t uploaded = 0; uploaded < images.size(); uploaded++)
+    {
+        DecodedImage image;
+        decoded.Pop(image);
+        if (!image.pixels)
+        {
+            result.failed++;
+            continue;
+        }
+
+        result.decodedBytes += static_cast<uint64_t>(image.width) * image.height * 4;
+        if (vulkan && firstError.empty())
+        {
+            try
+            {
+                vulkan->Upload(image, result.stages);
+            }
+            catch (const std::runtime_error& exception)
+            {
+                firstError = exception.what();
+            }
+        }
+        stbi_image_free(image.pixels);
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    if (!firstError.empty())
+        throw std::runtime_error(firstError);
+    if (vulkan)
+        vulkan->EndRun(result.stages);
+    result.wallMs = Milliseconds(start, Clock::now());
+
+    for (const StageTimes& times : workerTimes)
+    {
+        result.stages.read += times.read;
+        result.stages.decode += times.decode;
+        result.stages.convert += times.convert;
+        result.stages.hash += times.hash;
+    }
+    return result;
+}
+
+static std::vector<size_t> ParseThreads(const std::string& list)
+{
+    std::vector<size_t> threads;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        size_t count = static_cast<size_t>(std::strtoul(item.c_str(), nullptr, 10));
+        if (count)
+            threads.push_back(count);
+    }
+    return threads;
+}
+
+int main(int argc, char** argv)
+{
+    const char* usage = "Usage: LoadBench [image directory] [--threads 1,2,4] [--limit N] [--decode-only] [--cache] [--device name] [--output file.json]";
+
+    std::filesystem::path inputPath = "Textures/3000";
+    std::vector<size_t> threadCounts;
+    size_t limit = 0;
+    bool decodeOnly = false;
+    bool cached = false;
+    std::string deviceFilter;
+    std::string outputPath;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        std::string value = argv[arg];
+        bool hasNext = arg + 1 < argc;
+        if (value == "--decode-only")
+            decodeOnly = true;
+        else if (value == "--cache")
+            cached = USE_TEXTURE_CACHE;
+        else if (value == "--threads" && hasNext)
+            threadCounts = ParseThreads(argv[++arg]);
+        else if (value == "--limit" && hasNext)
+            limit = static_cast<size_t>(std::strtoull(argv[++arg], nullptr, 10));
+        else if (value == "--device" && hasNext)
+            deviceFilter = argv[++arg];
+        else if (value == "--output" && hasNext)
+            outputPath = argv[++arg];
+        else if (value.rfind("--", 0) != 0)
+            inputPath = value;
+        else
+        {
+            std::cerr << usage << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+#ifndef LOADBENCH_VULKAN
+    decodeOnly = true;
+#endif
+
+    if (!std::filesystem::is_directory(inputPath))
+    {
+        std::cerr << "Not a directory: " << inputPath << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    if (threadCounts.empty())
+    {
+        for (size_t count = 1; count < hardwareThreads; count *= 2)
+            threadCounts.push_back(count);
+        threadCounts.push_back(hardwareThreads);
+    }
+
+    // Directory scan is what AnimationLoader::Load does before anything else, timed once
+    auto start = Clock::now();
+    std::vector<std::string> images;
+    for (const auto& dirEntry : std::filesystem::directory_iterator(inputPath))
+    {
+        if (!dirEntry.is_regular_file())
+            continue;
+        images.push_back(dirEntry.path().generic_string());
+    }
+    std::sort(images.begin(), images.end());
+    if (limit && images.size() > limit)
+        images.resize(limit);
+    // Only the files that are actually loaded, so MB/s matches the images timed
+    uint64_t fileBytes = 0;
+    for (const std::string& image : images)
+        fileBytes += std::filesystem::file_size(image);
+    double scanMs = Milliseconds(start, Clock::now());
+
+    std::unique_ptr<HeadlessVulkan> vulkan;
+    std::string deviceName;
+    bool blitMipmaps = false;
+#ifdef LOADBENCH_VULKAN
+    if (!decodeOnly)
+    {
+        try
+        {
+            vulkan = std::make_unique<HeadlessVulkan>(deviceFilter);
+        }
+        catch (const std::runtime_error& exception)
+        {
+            std::cerr << exception.what() << " (use --decode-only without a Vulkan driver)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        deviceName = vulkan->GetDeviceName();
+        blitMipmaps = vulkan->GetBlitMipmaps();
+    }
+#endif
+
+    std::vector<RunResult> runs;
+    for (size_t threads : threadCounts)
+    {
+        try
+        {
+            runs.push_back(Run(images, threads, cached, vulkan.get()));
+        }
+        catch (const std::runtime_error& exception)
+        {
+            std::cerr << exception.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cerr << threads << " threads: " << runs.back().wallMs << " ms" << std::endl;
+    }
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"directory\": " << JsonString(inputPath.generic_string()) << ",\n";
+    json << "  \"mode\": " << JsonString(decodeOnly ? "decode-only" : "vulkan") << ",\n";
+    json << "  \"device\": " << JsonString(deviceName) << ",\n";
+    json << "  \"cache\": " << (cached ? "true" : "false") << ",\n";
+    json << "  \"blitMipmaps\": " << (blitMipmaps ? "true" : "false") << ",\n";
+    json << "  \"unfilter\": " << JsonString(GetPngUnfilterPath()) << ",\n";
+    json << "  \"hardwareThreads\": " << hardwareThreads << ",\n";
+    json << "  \"files\": " << images.size() << ",\n";
+    json << "  \"fileMB\": " << fileBytes / 1024.0 / 1024.0 << ",\n";
+    json << "  \"scanMs\": " << scanMs << ",\n";
+    json << "  \"runs\": [\n";
+    for (size_t it = 0; it < runs.size(); it++)
+    {
+        const RunResult& run = runs[it];
+        double seconds = run.wallMs / 1000.0;
+        json << "    {\n";
+        json << "      \"threads\": " << run.threads << ",\n";
+        json << "      \"images\": " << run.images << ",\n";
+        json << "      \"failed\": " << run.failed << ",\n";
+        json << "      \"decodedMB\": " << run.decodedBytes / 1024.0 / 1024.0 << ",\n";
+        json << "      \"wallMs\": " << run.wallMs << ",\n";
+        json << "      \"imagesPerSecond\": " << (run.images - run.failed) / seconds << ",\n";
+        json << "      \"mbPerSecond\": " << run.decodedBytes / 1024.0 / 1024.0 / seconds << ",\n";
+        json << "      \"speedup\": " << runs[0].wallMs / run.wallMs << ",\n";
+        json << "      \"stageMs\": { \"read\": " << run.stages.read << ", \"decode\": " << run.stages.decode
+             << ", \"convert\": " << run.stages.convert << ", \"hash\": " << run.stages.hash
+             << ", \"image\": " << run.stages.image << ", \"staging\": " << run.stages.staging
+             << ", \"descriptor\": " << run.stages.descriptor << ", \"gpuWait\": " << run.stages.gpuWait << " }\n";
+        json << "    }" << (it + 1 < runs.size() ? "," : "") << "\n";
+    }
+    json << "  ],\n";
+    json << "  \"peakRssMB\": " << PeakRssMB() << "\n";
+    json << "}\n";
+
+    std::cout << json.str();
+    if (!outputPath.empty())
+    {
+        std::ofstream output(outputPath);
+        output << json.str();
+        if (!output)
+        {
+            std::cerr << "Failed to write " << outputPath << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+// Decode benchmark: every image of a directory through stb_image and through FastPng on one thread
+// Usage: TextureBench [image directory], default Textures/3000
+// Files are read into memory first so only decoding is timed, FastPng output has to match stb byte for byte
+// MB/s are decoded RGBA8 bytes per second of a single core
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "FastPng.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double Milliseconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 2)
+    {
+        std::cout << "Usage: TextureBench [image directory]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::path inputPath = argc > 1 ? argv[1] : "Textures/3000";
+    if (!std::filesystem::is_directory(inputPath))
+    {
+        std::cout << "Not a directory: " << inputPath << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::filesystem::path> images;
+    for (const auto& dirEntry : std::filesystem::directory_iterator(inputPath))
+    {
+        if (dirEntry.is_regular_file())
+            images.push_back(dirEntry.path());
+    }
+    std::sort(images.begin(), images.end());
+
+    std::vector<std::vector<uint8_t>> files(images.size());
+    uint64_t fileBytes = 0;
+    for (size_t it = 0; it < images.size(); it++)
+    {
+        std::ifstream file(images[it], std::ios::binary | std::ios::ate);
+        files[it].resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(files[it].data()), files[it].size());
+        fileBytes += files[it].size();
+    }
+
+    double stbTime = 0.0;
+    double fastTime = 0.0;
+    uint64_t stbBytes = 0;
+    uint64_t fastBytes = 0;
+    size_t fastDecoded = 0;
+    size_t fallbacks = 0;
+    size_t failures = 0;
+    size_t mismatches = 0;
+
+    for (size_t it = 0; it < images.size(); it++)
+    {
+        const std::vector<uint8_t>& file = files[it];
+
+        int width = 0, height = 0, channels;
+        auto start = Clock::now();
+        stbi_uc* reference = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels, STBI_rgb_alpha);
+        auto end = Clock::now();
+        size_t size = static_cast<size_t>(width) * height * 4;
+        if (!reference)
+        {
+            failures++;
+            continue;
+        }
+        stbTime += Milliseconds(start, end);
+        stbBytes += size;
+
+        // Files FastPng refuses count as stb decodes on its side too, that's what LoadPngFile does with them
+        start = Clock::now();
+        PngInfo info;
+        uint8_t* pixels = nullptr;
+        if (ReadPngInfo(file.data(), file.size(), &info))
+        {
+            pixels = static_cast<uint8_t*>(malloc(static_cast<size_t>(info.width) * info.height * 4));
+            if (!DecodePng(file.data(), file.size(), pixels, static_cast<size_t>(info.width) * 4))
+            {
+                free(pixels);
+                pixels = nullptr;
+            }
+        }
+        if (!pixels)
+        {
+            int fallbackWidth, fallbackHeight;
+            pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &fallbackWidth, &fallbackHeight, &channels, STBI_rgb_alpha);
+            fallbacks++;
+        }
+        else
+        {
+            fastDecoded++;
+            if (info.width != static_cast<uint32_t>(width) || info.height != static_cast<uint32_t>(height) || memcmp(pixels, reference, size) != 0)
+            {
+                std::cout << "Output differs from stb_image: " << images[it] << std::endl;
+                mismatches++;
+            }
+        }
+        end = Clock::now();
+        fastTime += Milliseconds(start, end);
+        fastBytes += size;
+
+        free(pixels);
+        stbi_image_free(reference);
+    }
+
+    double stbRate = stbBytes / 1024.0 / 1024.0 / (stbTime / 1000.0);
+    double fastRate = fastBytes / 1024.0 / 1024.0 / (fastTime / 1000.0);
+    std::cout << images.size() << " files (" << fileBytes / 1024.0 / 1024.0 << " MB), " << failures << " not decodable" << std::endl;
+    std::cout << "FastPng decoded " << fastDecoded << ", left " << fallbacks << " to stb, unfilter: " << GetPngUnfilterPath() << std::endl;
+    std::cout << "stb_image: " << stbTime << " ms, " << stbRate << " MB/s per core" << std::endl;
+    std::cout << "FastPng:   " << fastTime << " ms, " << fastRate << " MB/s per core (" << stbTime / fastTime << "x)" << std::endl;
+
+    if (mismatches)
+    {
+        std::cout << mismatches << " images differ" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+// Offline packer: decodes every image of a directory once and stores the raw pixels in a *.pack
+// Usage: TexturePacker <image directory> [output.pack] [--format rgba8|bc1|bc3] [--straight]
+// Default output is <image directory>.pack which AnimationLoader picks up automatically
+// bc1/bc3 store the whole mip chain compressed, a quarter (bc3) or eighth (bc1) of the RGBA8 size per level
+// Colors are premultiplied by alpha before compressing like the loader does it, --straight keeps them as decoded
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "MipMaps.h"
+#include "PixelConvert.h"
+#include "TexturePack.h"
+#include "WorkQueue.h"
+
+struct PackedImage
+{
+    size_t index = 0;
+    stbi_uc* pixels = nullptr;
+    int width = 0, height = 0;
+    uint32_t mipLevels = 1;
+    std::vector<uint8_t> compressed; // every level back to back, empty for RGBA8
+};
+
+// Base level and the box filtered chain below it, each compressed on its own
+static std::vector<uint8_t> CompressChain(TexturePackFormat format, const stbi_uc* pixels, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    std::vector<size_t> offsets;
+    std::vector<uint8_t> chain = GenerateMipChain(pixels, width, height, mipLevels, &offsets);
+
+    std::vector<uint8_t> compressed(TextureChainSize(format, width, height, mipLevels));
+    uint8_t* output = compressed.data();
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        uint32_t levelWidth = std::max(1u, width >> level);
+        uint32_t levelHeight = std::max(1u, height >> level);
+        const uint8_t* levelPixels = level == 0 ? pixels : chain.data() + offsets[level - 1];
+        CompressImage(format, levelPixels, levelWidth, levelHeight, output);
+        output += TextureLevelSize(format, levelWidth, levelHeight);
+    }
+    return compressed;
+}
+
+int main(int argc, char** argv)
+{
+    const char* usage = "Usage: TexturePacker <image directory> [output.pack] [--format rgba8|bc1|bc3] [--straight]";
+
+    std::vector<std::string> paths;
+    TexturePackFormat format = TexturePackFormat::RGBA8;
+    uint32_t pixelConversions = PIXEL_PREMULTIPLY;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        std::string value = argv[arg];
+        if (value == "--straight")
+        {
+            pixelConversions = 0;
+            continue;
+        }
+        if (value != "--format")
+        {
+            paths.push_back(value);
+            continue;
+        }
+
+        std::string name = arg + 1 < argc ? argv[++arg] : "";
+        if (name == "rgba8")
+            format = TexturePackFormat::RGBA8;
+        else if (name == "bc1")
+            format = TexturePackFormat::BC1;
+        else if (name == "bc3")
+            format = TexturePackFormat::BC3;
+        else
+        {
+            std::cout << "Unknown format: " << name << std::endl << usage << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (paths.empty() || paths.size() > 2)
+    {
+        std::cout << usage << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::path inputPath = paths[0];
+    std::filesystem::path outputPath = paths.size() > 1 ? std::filesystem::path(paths[1]) : std::filesystem::path(inputPath.generic_string() + ".pack");
+
+    if (!std::filesystem::is_directory(inputPath))
+    {
+        std::cout << "Not a directory: " << inputPath << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Sorted so the pack has a stable frame order
+    std::vector<std::filesystem::path> images;
+    for (const auto& dirEntry : std::filesystem::directory_iterator(inputPath))
+    {
+        if (dirEntry.is_regular_file())
+            images.push_back(dirEntry.path());
+    }
+    std::sort(images.begin(), images.end());
+
+    std::vector<std::string> names;
+    for (const auto& image : images)
+        names.push_back(image.filename().generic_string());
+
+    TexturePackWriter writer;
+    if (!writer.Begin(outputPath.generic_string(), names, pixelConversions))
+    {
+        std::cout << "Failed to open " << outputPath << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    WorkQueue<PackedImage> decoded(64);
+    std::atomic<size_t> next = 0;
+    std::vector<std::thread> threads;
+    size_t numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t thread = 0; thread < numberOfThreads; thread++)
+    {
+        threads.emplace_back([&]()
+        {
+            for (size_t it = next++; it < images.size(); it = next++)
+            {
+                PackedImage image;
+                int channels;
+                image.index = it;
+                image.pixels = stbi_load(images[it].generic_string().c_str(), &image.width, &image.height, &channels, STBI_rgb_alpha);
+                if (image.pixels)
+                    ConvertPixels(image.pixels, image.width, image.height, static_cast<size_t>(image.width) * 4, pixelConversions);
+
+                // Compression is the slow part, keep it on the workers
+                if (image.pixels && IsBlockCompressed(format))
+                {
+                    image.mipLevels = MipLevelCount(image.width, image.height);
+                    image.compressed = CompressChain(format, image.pixels, image.width, image.height, image.mipLevels);
+                    stbi_image_free(image.pixels);
+                    image.pixels = nullptr;
+                }
+                decoded.Push(std::move(image));
+            }
+        });
+    }
+
+    bool failed = false;
+    uint64_t totalBytes = 0;
+    for (size_t written = 0; written < images.size(); written++)
+    {
+        PackedImage image;
+        decoded.Pop(image);
+
+        if (!image.pixels && image.compressed.empty())
+        {
+            std::cout << "Failed to load an image: " << images[image.index] << std::endl;
+            failed = true;
+            continue;
+        }
+
+        const void* data = image.pixels ? static_cast<const void*>(image.pixels) : image.compressed.data();
+        uint64_t size = image.pixels ? uint64_t(image.width) * uint64_t(image.height) * 4 : image.compressed.size();
+        if (!writer.AddImage(image.index, image.width, image.height, format, image.mipLevels, data, size))
+        {
+            std::cout << "Failed to write " << outputPath << std::endl;
+            failed = true;
+        }
+        totalBytes += size;
+        if (image.pixels)
+            stbi_image_free(image.pixels);
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    if (failed || !writer.Finish())
+    {
+        std::filesystem::remove(outputPath);
+        return EXIT_FAILURE;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double difference = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << "Packed " << images.size() << " images (" << totalBytes / 1024.0 / 1024.0 << " MB) into " << outputPath << " in " << difference << " ms" << std::endl;
+
+    return EXIT_SUCCESS;
+}
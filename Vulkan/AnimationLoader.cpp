@@ -1,7 +1,12 @@
 #include "AnimationLoader.h"
 #include <chrono>
-
-std::recursive_mutex AnimationLoader::m_lock;
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include "MappedFile.h"
+#include "TextureDecode.h"
 
 AnimationLoader::AnimationLoader(const std::string& path, VulkanRenderer* r)
 {
@@ -29,92 +34,602 @@ AnimationLoader::AnimationLoader(const std::string& path, unsigned int rangedMin
     this->rangeMax = rangeMax;
 }
 
-void ThreadHelperFunc(std::vector<std::string>& images, size_t lowerBound, size_t upperBound, VulkanRenderer* renderer)
+void AnimationLoader::DecodeWorker(const std::vector<std::string>& images, WorkQueue<DecodeJob>& jobs, WorkQueue<DecodedImage>& decoded) const
 {
-    for (size_t it = lowerBound; it < upperBound; it++)
+    // Workers only decode and read the content registry, Vulkan is never touched outside of the upload thread
+    DecodeJob job;
+    while (jobs.Pop(job))
     {
-        VulkanRenderer::imagesID[images[it]] = renderer->CreateTexture(images[it]);
+        DecodedImage image;
+        image.index = job.index;
+
+        // With dst straight into mapped staging, the upload thread only records the copy
+        // Every job reports back, even failed ones, so the upload thread never waits for a frame that isn't coming
+        try
+        {
+            DecodedTexture texture;
+            if (!DecodeTexture(images[job.index], USE_TEXTURE_CACHE, job.dst, job.width, job.height, &texture))
+                throw std::runtime_error("Failed to load an image: " + images[job.index]);
+            image.pixels = texture.pixels;
+            image.width = static_cast<int>(texture.width);
+            image.height = static_cast<int>(texture.height);
+            image.size = texture.size;
+            image.hash = texture.hash;
+            image.staged = job.dst != nullptr;
+
+            // The byte check runs here, in parallel, the upload thread only takes the result
+            // A copy registered while this frame was decoding is missed and the frame uploaded on its own
+            if (job.dedupe)
+                FindDuplicate(image.hash, image.pixels, image.size, images[job.index], &image.duplicate);
+        }
+        catch (...)
+        {
+            image.error = std::current_exception();
+        }
+        decoded.Push(std::move(image));
     }
-    std::cout << "Thread finished: " << std::this_thread::get_id() << std::endl;
 }
 
-std::vector<Mesh> AnimationLoader::Load()
+void AnimationLoader::DecodeThreaded(const std::vector<std::string>& images, bool dedupe, const std::function<void(size_t, const DecodedImage&)>& upload,
+    const std::function<void(DecodeJob&)>& reserve)
 {
-    std::vector<Mesh> meshesLoaded;
-    std::vector<std::string> pathsToImages;
-    if (std::filesystem::is_directory(m_path))
+    size_t numberOfThreads = NUMBER_OF_THREADS ? NUMBER_OF_THREADS : std::max(1u, std::thread::hardware_concurrency());
+    numberOfThreads = std::min(numberOfThreads, std::max<size_t>(images.size(), 1));
+
+    // At most DECODE_QUEUE_CAPACITY frames are handed out and not uploaded yet, that bounds memory and reserved staging
+    WorkQueue<DecodeJob> jobs;
+    WorkQueue<DecodedImage> decoded(DECODE_QUEUE_CAPACITY);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < numberOfThreads; thread++)
     {
-        for (const auto& dirEntry : std::filesystem::directory_iterator(m_path))
-            pathsToImages.push_back(dirEntry.path().generic_string());
+        threads.emplace_back(&AnimationLoader::DecodeWorker, this, std::cref(images), std::ref(jobs), std::ref(decoded));
     }
 
-    if (rangeMin == -1 || rangeMax == -1)
+    // Anything thrown here is kept until the workers are joined, a joinable std::thread would terminate on unwinding
+    std::exception_ptr firstError;
+    size_t dispatched = 0;
+    auto dispatch = [&]()
     {
-        rangeMin = 0;
-        rangeMax = pathsToImages.size();
+        DecodeJob job;
+        job.index = dispatched++;
+        job.dedupe = dedupe;
+        if (reserve)
+            reserve(job);
+        jobs.Push(job);
+    };
+
+    try
+    {
+        while (dispatched < images.size() && dispatched < DECODE_QUEUE_CAPACITY)
+            dispatch();
     }
-    auto start = std::chrono::high_resolution_clock::now();
-    if (USE_THREAD_LOADING)
+    catch (...)
     {
+        firstError = std::current_exception();
+    }
+
+    // This thread is the only one uploading, it drains frames in whatever order workers finish them
+    for (size_t uploaded = 0; uploaded < dispatched; uploaded++)
+    {
+        DecodedImage image;
+        decoded.Pop(image);
+
+        if (!image.pixels)
+        {
+            if (!firstError)
+                firstError = image.error;
+            continue;
+        }
+
+        // After an error nothing new is handed out, what is already out is drained so no worker stays blocked
+        if (!firstError)
+        {
+            try
+            {
+                upload(image.index, image);
+                if (dispatched < images.size())
+                    dispatch();
+            }
+            catch (...)
+            {
+                firstError = std::current_exception();
+            }
+        }
+        if (!image.staged)
+            stbi_image_free(image.pixels);
+    }
+
+    jobs.Close();
+    for (auto& thread : threads)
+        thread.join();
+
+    if (firstError)
+        std::rethrow_exception(firstError);
+}
+
+std::vector<AnimationLoader::FrameTexture> AnimationLoader::LoadTexturesThreaded(const std::vector<std::string>& images)
+{
+    // Preallocated table, every decoded frame writes its own slot so order of completion does not matter
+    std::vector<FrameTexture> frames(images.size());
+
+    // Frames already loaded are resolved here and never reach decode workers, a file listed twice is decoded once
+    std::vector<std::string> pending;
+    std::vector<size_t> pendingSlots;
+    std::unordered_map<std::string, size_t> pendingByName;
+    std::vector<std::pair<size_t, size_t>> repeats; // frame slot, pending index it copies
+    for (size_t it = 0; it < images.size(); it++)
+    {
+        int texId = renderer->textureRegistry.Find(images[it]);
+        if (texId != -1)
+        {
+            frames[it].texId = texId;
+            continue;
+        }
+
+        auto first = pendingByName.emplace(images[it], pending.size());
+        if (!first.second)
+        {
+            repeats.emplace_back(it, first.first->second);
+            continue;
+        }
+        pending.push_back(images[it]);
+        pendingSlots.push_back(it);
+    }
+
+    renderer->ReserveTextures(pending.size());
+
+    DecodeThreaded(pending, USE_TEXTURE_DEDUPE, [&](size_t index, const DecodedImage& image)
+    {
+        FrameTexture& frame = frames[pendingSlots[index]];
+        if (image.duplicate.texId != -1)
+        {
+            frame = image.duplicate;
+            UseDuplicate(frame, image.size);
+            // Later lookups of this file find the shared texture, as long as it is a whole texture and not an array layer
+            if (frame.layer == 0 && renderer->textures[frame.texId].info.layerCount == 1)
+                renderer->textureRegistry.GetOrLoad(pending[index], [&]() { return frame.texId; });
+            return;
+        }
+
+        frame.texId = renderer->CreateTexture(pending[index], image.pixels, image.width, image.height, image.size);
+        renderer->SetTextureSource(frame.texId, 0, { nullptr, 0, pending[index] });
+        RegisterContent(image.hash, frame, { nullptr, 0, pending[index] });
+    });
+
+    for (const auto& repeat : repeats)
+        frames[repeat.first] = frames[pendingSlots[repeat.second]];
+
+    return frames;
+}
+
+std::vector<AnimationLoader::FrameTexture> AnimationLoader::AllocateTextureArrays(const std::vector<FrameFormat>& formats)
+{
+    std::vector<FrameTexture> frames(formats.size());
 
-        size_t numberOfElementsPerThread = (rangeMax - rangeMin) / NUMBER_OF_THREADS;
-        std::vector<std::thread> threads;
+    // Frames of the same size and format share an array, each array holds at most TEXTURE_ARRAY_MAX_LAYERS
+    std::map<FrameFormat, std::vector<size_t>> groups;
+    for (size_t it = 0; it < formats.size(); it++)
+        groups[formats[it]].push_back(it);
 
-        for (size_t thread = 0; thread < NUMBER_OF_THREADS; thread++)
+    uint32_t maxLayers = std::min<uint32_t>(TEXTURE_ARRAY_MAX_LAYERS, renderer->GetMaxTextureArrayLayers());
+    for (const auto& group : groups)
+    {
+        const auto& members = group.second;
+        for (size_t first = 0; first < members.size(); first += maxLayers)
         {
-            threads.emplace_back(ThreadHelperFunc, std::ref(pathsToImages), thread * numberOfElementsPerThread, ((thread == NUMBER_OF_THREADS - 1) ? rangeMax : (thread + 1) * numberOfElementsPerThread), renderer);
+            uint32_t layerCount = static_cast<uint32_t>(std::min<size_t>(maxLayers, members.size() - first));
+            const FrameFormat& format = group.first;
+            int texId = renderer->BeginTextureArray(format.width, format.height, layerCount, format.format, format.mipLevels);
+            for (uint32_t layer = 0; layer < layerCount; layer++)
+            {
+                frames[members[first + layer]] = { texId, static_cast<int>(layer) };
+            }
         }
+    }
+
+    return frames;
+}
 
-        for (size_t thread = 0; thread < NUMBER_OF_THREADS; thread++)
-            threads[thread].join();
+void AnimationLoader::FinishTextureArrays(const std::vector<FrameTexture>& frames)
+{
+    std::set<int> arrays;
+    for (const auto& frame : frames)
+        arrays.insert(frame.texId);
+
+    for (int texId : arrays)
+        renderer->EndTextureArray(texId);
+}
 
-        for (size_t tex = rangeMin; tex < rangeMax; tex++)
+std::vector<AnimationLoader::FrameTexture> AnimationLoader::LoadTextureArraysThreaded(const std::vector<std::string>& images)
+{
+    // Only headers are read here, sizes are needed to create the arrays before any pixel is decoded
+    std::vector<FrameFormat> formats(images.size());
+    for (size_t it = 0; it < images.size(); it++)
+    {
+        int width, height, channels;
+        if (!stbi_info(images[it].c_str(), &width, &height, &channels))
         {
-            auto size = 0.5f;
+            throw std::runtime_error("Failed to load an image: " + images[it]);
+        }
+        formats[it].width = static_cast<uint32_t>(width);
+        formats[it].height = static_cast<uint32_t>(height);
+    }
+
+    // Layers are handed out before anything is decoded, so a duplicate found afterwards would still hold its layer
+    // Frames aren't deduped on this path, they are only registered for later loads to find
+    std::vector<FrameTexture> frames = AllocateTextureArrays(formats);
 
-            auto posX = distributionX(mtRand);
-            auto posY = distributionY(mtRand);
-            //auto posZ = distributionX(mtRand) + 0.5f;
+    // Workers decode into staging reserved for the frame's layer, so pixels are never copied on this thread
+    std::vector<UploadBatch::ImageWrite> writes(images.size());
+    auto reserve = [&](DecodeJob& job)
+    {
+        UploadBatch::ImageWrite& write = writes[job.index];
+        if (!renderer->ReserveTextureLayer(frames[job.index].texId, &write))
+            return;
+        job.dst = write.mapped;
+        job.width = formats[job.index].width;
+        job.height = formats[job.index].height;
+    };
 
-            // Take random position for testing
-            std::vector<Vertex> meshVertices =
+    // Whatever is still reserved here belongs to frames that failed or were never uploaded
+    auto cancelReserved = [&]()
+    {
+        for (const auto& write : writes)
+        {
+            if (write.mapped)
+                renderer->CancelTextureLayer(write);
+        }
+    };
+
+    try
+    {
+        DecodeThreaded(images, false, [&](size_t index, const DecodedImage& image)
+        {
+            renderer->SetTextureSource(frames[index].texId, frames[index].layer, { nullptr, 0, images[index] });
+            if (image.staged)
             {
-                    { { posX, posY, 1.0f },{ 0.0f, 0.0f, 0.0f }, {0.0f, 0.0f}, 1.0f},	// 0
-                    { { posX, posY - size, 1.0f },{ 0.0f, 0.0f, 0.0f }, {0.0f, 1.0f}, 1.0f},	    // 1
-                    { { posX + size, posY - size, 1.0f },{ 0.0f, 0.0f, 0.0f }, {1.0f, 1.0f}, 1.0f },    // 2
-                    { { posX + size, posY, 1.0f },{ 0.0f, 0.0f, 0.0f }, {1.0f, 0.0f}, 1.0f  },   // 3
-            };
+                renderer->CommitTextureLayer(frames[index].texId, frames[index].layer, writes[index]);
+                writes[index] = {};
+            }
+            else
+            {
+                const stbi_uc* layers[] = { image.pixels };
+                renderer->UploadTextureArrayLayers(frames[index].texId, frames[index].layer, 1, layers);
+            }
+            RegisterContent(image.hash, frames[index], { nullptr, 0, images[index] });
+        }, reserve);
+    }
+    catch (...)
+    {
+        cancelReserved();
+        throw;
+    }
+    cancelReserved();
+
+    FinishTextureArrays(frames);
+    return frames;
+}
 
-            meshesLoaded.emplace_back(renderer->mainDevice.physicalDevice, renderer->mainDevice.logicalDevice, renderer->graphicsQueue, renderer->graphicsCommandPool, &meshVertices, &MESH_INDICES, VulkanRenderer::imagesID[pathsToImages[tex]]);
+std::vector<AnimationLoader::FrameTexture> AnimationLoader::LoadTexturesFromPack(const std::shared_ptr<TexturePack>& pack, const std::filesystem::path& imageDirectory)
+{
+    if (rangeMin == -1 || rangeMax == -1)
+    {
+        rangeMin = 0;
+        rangeMax = pack->Count();
+    }
+    rangeMax = std::min<long long>(rangeMax, pack->Count());
+    rangeMin = std::min(rangeMin, rangeMax);
+
+    for (long long tex = rangeMin; tex < rangeMax; tex++)
+    {
+        const TexturePackEntry& entry = pack->Entry(tex);
+        TexturePackFormat format = static_cast<TexturePackFormat>(entry.format);
+        if (entry.format > static_cast<uint32_t>(TexturePackFormat::BC3) || entry.mipLevels == 0 ||
+            entry.size < TextureChainSize(format, entry.width, entry.height, IsBlockCompressed(format) ? entry.mipLevels : 1))
+        {
+            throw std::runtime_error("Unsupported texture pack entry: " + pack->Name(tex));
         }
     }
+
+    size_t count = static_cast<size_t>(rangeMax - rangeMin);
+    std::vector<uint64_t> hashes = HashPackEntries(*pack, rangeMin, count);
+    auto entrySize = [&](size_t tex)
+    {
+        const TexturePackEntry& entry = pack->Entry(tex);
+        TexturePackFormat format = static_cast<TexturePackFormat>(entry.format);
+        return TextureChainSize(format, entry.width, entry.height, IsBlockCompressed(format) ? entry.mipLevels : 1);
+    };
+
+    // Pixels are already decoded (or compressed with their mips), copy them straight from the mapping into staging
+    std::vector<FrameTexture> frames;
+    if (USE_TEXTURE_ARRAYS)
+    {
+        // Hashes are known up front, so duplicates never get a layer
+        frames.resize(count);
+        std::vector<size_t> unique;
+        std::vector<size_t> copyOf(count, SIZE_MAX);
+        std::unordered_map<uint64_t, size_t> firstInPack;
+        std::vector<FrameFormat> formats;
+        for (size_t frame = 0; frame < count; frame++)
+        {
+            if (FindDuplicate(hashes[frame], pack->Pixels(rangeMin + frame), entrySize(rangeMin + frame), std::string(), &frames[frame]))
+            {
+                UseDuplicate(frames[frame], entrySize(rangeMin + frame));
+                continue;
+            }
+
+            if (USE_TEXTURE_DEDUPE)
+            {
+                auto inserted = firstInPack.emplace(hashes[frame], frame);
+                if (!inserted.second && SameContent({ pack, static_cast<size_t>(rangeMin + inserted.first->second) }, pack->Pixels(rangeMin + frame), entrySize(rangeMin + frame), std::string()))
+                {
+                    copyOf[frame] = inserted.first->second;
+                    continue;
+                }
+            }
+
+            const TexturePackEntry& entry = pack->Entry(rangeMin + frame);
+            formats.push_back({ entry.width, entry.height, static_cast<TexturePackFormat>(entry.format), entry.mipLevels });
+            unique.push_back(frame);
+        }
+
+        std::vector<FrameTexture> allocated = AllocateTextureArrays(formats);
+        for (size_t it = 0; it < unique.size(); it++)
+        {
+            size_t frame = unique[it];
+            frames[frame] = allocated[it];
+
+            const stbi_uc* layers[] = { pack->Pixels(rangeMin + frame) };
+            renderer->UploadTextureArrayLayers(frames[frame].texId, frames[frame].layer, 1, layers);
+            renderer->SetTextureSource(frames[frame].texId, frames[frame].layer, { pack, static_cast<size_t>(rangeMin + frame) });
+            RegisterContent(hashes[frame], frames[frame], { pack, static_cast<size_t>(rangeMin + frame) });
+        }
+        for (size_t frame = 0; frame < count; frame++)
+        {
+            if (copyOf[frame] == SIZE_MAX)
+                continue;
+            frames[frame] = frames[copyOf[frame]];
+            UseDuplicate(frames[frame], entrySize(rangeMin + frame));
+        }
+        FinishTextureArrays(allocated);
+    }
     else
     {
-        for (size_t tex = rangeMin; tex < rangeMax; tex++)
+        renderer->ReserveTextures(rangeMax - rangeMin);
+        for (long long tex = rangeMin; tex < rangeMax; tex++)
         {
-            auto size = 0.5f;
+            const TexturePackEntry& entry = pack->Entry(tex);
+            std::string name = (imageDirectory / pack->Name(tex)).generic_string();
+
+            FrameTexture frame;
+            uint64_t hash = USE_TEXTURE_DEDUPE ? hashes[tex - rangeMin] : 0;
+            if (FindDuplicate(hash, pack->Pixels(tex), entrySize(tex), std::string(), &frame))
+            {
+                UseDuplicate(frame, entrySize(tex));
+            }
+            else
+            {
+                frame.texId = renderer->CreateTexture(name, pack->Pixels(tex), entry.width, entry.height, static_cast<TexturePackFormat>(entry.format), entry.mipLevels);
+                renderer->SetTextureSource(frame.texId, 0, { pack, static_cast<size_t>(tex) });
+                RegisterContent(hash, frame, { pack, static_cast<size_t>(tex) });
+            }
+            frames.push_back(frame);
+        }
+    }
+
+    return frames;
+}
 
-            auto posX = distributionX(mtRand);
-            auto posY = distributionY(mtRand);
-            //auto posZ = distributionX(mtRand) + 0.5f;
+std::vector<uint64_t> AnimationLoader::HashPackEntries(const TexturePack& pack, size_t first, size_t count)
+{
+    std::vector<uint64_t> hashes;
+    if (!USE_TEXTURE_DEDUPE)
+        return hashes;
+
+    // Reading the blobs is most of the cost (pages come in from the mapping), so spread it like decoding
+    hashes.resize(count);
+    size_t numberOfThreads = NUMBER_OF_THREADS ? NUMBER_OF_THREADS : std::max(1u, std::thread::hardware_concurrency());
+    numberOfThreads = std::min(numberOfThreads, std::max<size_t>(count, 1));
 
-            // Take random position for testing
-            std::vector<Vertex> meshVertices =
+    std::atomic<size_t> next = 0;
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < numberOfThreads; thread++)
+    {
+        threads.emplace_back([&]()
+        {
+            for (size_t it = next++; it < count; it = next++)
             {
-                    { { posX, posY, 1.0f },{ 0.0f, 0.0f, 0.0f }, {0.0f, 0.0f}, 1.0f},	// 0
-                    { { posX, posY - size, 1.0f },{ 0.0f, 0.0f, 0.0f }, {0.0f, 1.0f}, 1.0f},	    // 1
-                    { { posX + size, posY - size, 1.0f },{ 0.0f, 0.0f, 0.0f }, {1.0f, 1.0f}, 1.0f },    // 2
-                    { { posX + size, posY, 1.0f },{ 0.0f, 0.0f, 0.0f }, {1.0f, 0.0f}, 1.0f  },   // 3
-            };
+                const TexturePackEntry& entry = pack.Entry(first + it);
+                TexturePackFormat format = static_cast<TexturePackFormat>(entry.format);
+                uint64_t size = TextureChainSize(format, entry.width, entry.height, IsBlockCompressed(format) ? entry.mipLevels : 1);
+                hashes[it] = HashTexture(pack.Pixels(first + it), size, entry.width, entry.height, entry.format);
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+    return hashes;
+}
+
+bool AnimationLoader::FindDuplicate(uint64_t hash, const uint8_t* pixels, uint64_t size, const std::string& fileName, FrameTexture* frame) const
+{
+    if (!USE_TEXTURE_DEDUPE)
+        return false;
+
+    TextureRegistry::ContentLocation location;
+    if (!renderer->textureRegistry.FindContent(hash, &location) || !SameContent(location.source, pixels, size, fileName))
+        return false;
+
+    frame->texId = location.texId;
+    frame->layer = location.layer;
+    return true;
+}
+
+bool AnimationLoader::SameContent(const TextureLayerSource& source, const uint8_t* pixels, uint64_t size, const std::string& fileName)
+{
+    // Only bytes that are already mapped are compared, nothing is decoded a second time
+    if (source.pack)
+    {
+        const TexturePackEntry& entry = source.pack->Entry(source.entry);
+        TexturePackFormat format = static_cast<TexturePackFormat>(entry.format);
+        uint64_t entrySize = TextureChainSize(format, entry.width, entry.height, IsBlockCompressed(format) ? entry.mipLevels : 1);
+        return entrySize == size && memcmp(source.pack->Pixels(source.entry), pixels, size) == 0;
+    }
+
+    // Two image files decode the same when their bytes are the same
+    // Equal pixels stored in different files are missed, that only costs the texture it would have saved
+    if (fileName.empty())
+        return false;
+    MappedFile original, file;
+    if (!original.Open(source.fileName) || !file.Open(fileName))
+        return false;
+    return original.Size() == file.Size() && memcmp(original.Data(), file.Data(), file.Size()) == 0;
+}
+
+void AnimationLoader::UseDuplicate(const FrameTexture& frame, uint64_t size)
+{
+    // Every frame on the texture would see a region update, so the renderer refuses those from now on
+    renderer->textureRegistry.MarkShared(frame.texId);
+    dedupedFrames++;
+    dedupedBytes += size;
+}
+
+void AnimationLoader::RegisterContent(uint64_t hash, const FrameTexture& frame, TextureLayerSource source)
+{
+    if (USE_TEXTURE_DEDUPE)
+        renderer->textureRegistry.RegisterContent(hash, { frame.texId, frame.layer, std::move(source) });
+}
+
+Mesh AnimationLoader::CreateRandomMesh(const FrameTexture& frame)
+{
+    auto size = 0.5f;
+
+    auto posX = distributionX(mtRand);
+    auto posY = distributionY(mtRand);
+    //auto posZ = distributionX(mtRand) + 0.5f;
+
+    // Take random position for testing
+    std::vector<Vertex> meshVertices =
+    {
+            { { posX, posY, 1.0f },{ 0.0f, 0.0f, 0.0f }, {0.0f, 0.0f}, 1.0f},	// 0
+            { { posX, posY - size, 1.0f },{ 0.0f, 0.0f, 0.0f }, {0.0f, 1.0f}, 1.0f},	    // 1
+            { { posX + size, posY - size, 1.0f },{ 0.0f, 0.0f, 0.0f }, {1.0f, 1.0f}, 1.0f },    // 2
+            { { posX + size, posY, 1.0f },{ 0.0f, 0.0f, 0.0f }, {1.0f, 0.0f}, 1.0f  },   // 3
+    };
 
-            meshesLoaded.emplace_back(renderer->mainDevice.physicalDevice, renderer->mainDevice.logicalDevice, renderer->graphicsQueue, renderer->graphicsCommandPool, &meshVertices, &MESH_INDICES, renderer->CreateTexture(pathsToImages[tex]));
+    Mesh mesh(*renderer->deviceAllocator, renderer->mainDevice.logicalDevice, renderer->GetUploadBatch(), &meshVertices, &MESH_INDICES, frame.texId);
+    mesh.SetTextureLayer(frame.layer);
+    return mesh;
+}
+
+std::vector<Mesh> AnimationLoader::Load()
+{
+    std::vector<Mesh> meshesLoaded;
+    dedupedFrames = 0;
+    dedupedBytes = 0;
+
+    // Pack lives next to the animation directory, e.g. Textures/3000.pack for Textures/3000
+    std::filesystem::path imageDirectory = m_path;
+    std::filesystem::path packPath = m_path;
+    if (packPath.extension() == ".pack")
+        imageDirectory.replace_extension();
+    else
+        packPath += ".pack";
+
+    // Shared with the residency sources so evicted frames can be read from the mapping again
+    std::shared_ptr<TexturePack> pack;
+    bool packOutdated = false;
+    if (USE_TEXTURE_PACKS && std::filesystem::is_regular_file(packPath))
+    {
+        pack = std::make_shared<TexturePack>();
+        if (!pack->Open(packPath.generic_string()))
+        {
+            throw std::runtime_error("Failed to open texture pack: " + packPath.generic_string());
+        }
+
+        // Pack pixels have to be what the loader threads would make of the images (premultiplied or not...)
+        if (pack->PixelConversions() != TEXTURE_PIXEL_CONVERSIONS)
+        {
+            packOutdated = true;
+            pack.reset();
         }
     }
-    auto end = std::chrono::high_resolution_clock::now();
-    double difference = std::chrono::duration<double, std::milli>(end - start).count();
 
-    std::cout << "Loading time: " << difference << std::endl;
+    if (pack)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // All textures and meshes share a few submits instead of one wait per upload
+        {
+            UploadScope upload(renderer->GetUploadBatch());
+            for (const auto& frame : LoadTexturesFromPack(pack, imageDirectory))
+            {
+                meshesLoaded.push_back(CreateRandomMesh(frame));
+            }
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        PrintLoadSummary(std::chrono::duration<double, std::milli>(end - start).count(), true, false);
+        return meshesLoaded;
+    }
+
+    std::vector<std::string> pathsToImages;
+    if (std::filesystem::is_directory(imageDirectory))
+    {
+        for (const auto& dirEntry : std::filesystem::directory_iterator(imageDirectory))
+            pathsToImages.push_back(dirEntry.path().generic_string());
+    }
+
+    if (rangeMin == -1 || rangeMax == -1)
+    {
+        rangeMin = 0;
+        rangeMax = pathsToImages.size();
+    }
+    rangeMax = std::min<long long>(rangeMax, pathsToImages.size());
+    rangeMin = std::min(rangeMin, rangeMax);
 
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        UploadScope upload(renderer->GetUploadBatch());
+        if (USE_THREAD_LOADING)
+        {
+            std::vector<std::string> images(pathsToImages.begin() + rangeMin, pathsToImages.begin() + rangeMax);
+            std::vector<FrameTexture> frames = USE_TEXTURE_ARRAYS ? LoadTextureArraysThreaded(images) : LoadTexturesThreaded(images);
+
+            meshesLoaded.reserve(frames.size());
+            for (const auto& frame : frames)
+            {
+                meshesLoaded.push_back(CreateRandomMesh(frame));
+            }
+        }
+        else
+        {
+            for (long long tex = rangeMin; tex < rangeMax; tex++)
+            {
+                FrameTexture frame;
+                frame.texId = renderer->CreateTexture(pathsToImages[tex]);
+                meshesLoaded.push_back(CreateRandomMesh(frame));
+            }
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    PrintLoadSummary(std::chrono::duration<double, std::milli>(end - start).count(), false, packOutdated);
     return meshesLoaded;
 }
 
+void AnimationLoader::PrintLoadSummary(double milliseconds, bool fromPack, bool packOutdated) const
+{
+    // One line per load, the extras only when they are turned on
+    std::cout << "Loading time: " << milliseconds;
+    if (fromPack)
+        std::cout << " (pack)";
+    if (packOutdated)
+        std::cout << " (pack skipped, made with other pixel conversions, rerun TexturePacker)";
+    if (USE_TEXTURE_CACHE && !fromPack)
+        std::cout << ", texture cache hits: " << TextureCache::GetInstance().GetHits() << ", misses: " << TextureCache::GetInstance().GetMisses();
+    if (USE_TEXTURE_DEDUPE)
+        std::cout << ", deduplicated frames: " << dedupedFrames << " (" << dedupedBytes / 1024.0 / 1024.0 << " MB)";
+    std::cout << std::endl;
+}
+
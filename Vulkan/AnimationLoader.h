@@ -7,6 +7,12 @@
 #include "Mesh.h"
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <tuple>
+#include "WorkQueue.h"
+#include "TexturePack.h"
 class VulkanRenderer;
 class Mesh;
 
@@ -21,10 +27,76 @@ private:
 	std::uniform_real_distribution<float> distributionY;
 	long long rangeMin, rangeMax;
 
+	// Texture a frame ended up in, layer is 0 unless the frame lives in a texture array
+	struct FrameTexture
+	{
+		int texId = -1;
+		int layer = 0;
+	};
+
+	// Frame handed to a worker, decoded into dst (reserved staging of width x height) when set, into a new buffer otherwise
+	struct DecodeJob
+	{
+		size_t index = 0;
+		uint8_t* dst = nullptr;
+		uint32_t width = 0, height = 0;
+		bool dedupe = false; // look the pixels up in the content registry after decoding
+	};
+
+	// Frame decoded by a worker thread, waiting for the upload thread
+	struct DecodedImage
+	{
+		size_t index = 0;
+		stbi_uc* pixels = nullptr;
+		int width = 0, height = 0;
+		VkDeviceSize size = 0;
+		uint64_t hash = 0;   // HashTexture of the pixels when USE_TEXTURE_DEDUPE
+		bool staged = false; // pixels are the job's dst, nothing to free
+		FrameTexture duplicate; // texId set when the worker found these exact pixels already uploaded
+		std::exception_ptr error;
+	};
+
+	// Frames only share an array when all of this matches
+	struct FrameFormat
+	{
+		uint32_t width = 0, height = 0;
+		TexturePackFormat format = TexturePackFormat::RGBA8;
+		uint32_t mipLevels = 1;
+
+		bool operator<(const FrameFormat& other) const
+		{
+			return std::tie(width, height, format, mipLevels) < std::tie(other.width, other.height, other.format, other.mipLevels);
+		}
+	};
+
+	void DecodeWorker(const std::vector<std::string>& images, WorkQueue<DecodeJob>& jobs, WorkQueue<DecodedImage>& decoded) const;
+	// reserve runs on this thread before a frame goes to the workers and may point the job at staging memory
+	// With dedupe the workers also look for an uploaded copy of each frame, see DecodedImage::duplicate
+	void DecodeThreaded(const std::vector<std::string>& images, bool dedupe, const std::function<void(size_t, const DecodedImage&)>& upload,
+		const std::function<void(DecodeJob&)>& reserve = nullptr);
+	std::vector<FrameTexture> LoadTexturesThreaded(const std::vector<std::string>& images);
+	std::vector<FrameTexture> LoadTextureArraysThreaded(const std::vector<std::string>& images);
+	std::vector<FrameTexture> LoadTexturesFromPack(const std::shared_ptr<TexturePack>& pack, const std::filesystem::path& imageDirectory);
+	std::vector<FrameTexture> AllocateTextureArrays(const std::vector<FrameFormat>& formats);
+
+	// Frames that reused an existing texture during the last Load
+	size_t dedupedFrames = 0;
+	uint64_t dedupedBytes = 0;
+
+	std::vector<uint64_t> HashPackEntries(const TexturePack& pack, size_t first, size_t count);
+	// A hash match only counts once the registered source holds the same bytes, fileName is where pixels came from (empty for packs)
+	// Safe to call from decode workers, UseDuplicate is for the thread that hands the match to a frame
+	bool FindDuplicate(uint64_t hash, const uint8_t* pixels, uint64_t size, const std::string& fileName, FrameTexture* frame) const;
+	static bool SameContent(const TextureLayerSource& source, const uint8_t* pixels, uint64_t size, const std::string& fileName);
+	void UseDuplicate(const FrameTexture& frame, uint64_t size);
+	void RegisterContent(uint64_t hash, const FrameTexture& frame, TextureLayerSource source);
+	void FinishTextureArrays(const std::vector<FrameTexture>& frames);
+	void PrintLoadSummary(double milliseconds, bool fromPack, bool packOutdated) const;
+	Mesh CreateRandomMesh(const FrameTexture& frame);
+
 public:
 	AnimationLoader(const std::string& path, VulkanRenderer* renderer);
 	AnimationLoader(const std::string& path, unsigned int rangedMin, unsigned int rangeMax, VulkanRenderer* renderer);
 	std::vector<Mesh> Load();
-	static std::recursive_mutex m_lock;
 };
 
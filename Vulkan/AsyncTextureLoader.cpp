@@ -0,0 +1,49 @@
+#include "AsyncTextureLoader.h"
+
+#include "TextureCache.h"
+#include "Utilites.h"
+
+void AsyncTexture::Release()
+{
+    stbi_image_free(pixels);
+    pixels = nullptr;
+}
+
+AsyncTextureLoader::AsyncTextureLoader(size_t threadCount)
+{
+    for (size_t thread = 0; thread < threadCount; thread++)
+        m_workers.emplace_back(&AsyncTextureLoader::Worker, this);
+}
+
+AsyncTextureLoader::~AsyncTextureLoader()
+{
+    m_requests.Close();
+    for (auto& worker : m_workers)
+        worker.join();
+
+    // Loaded after the last frame, never uploaded
+    AsyncTexture texture;
+    while (m_loaded.TryPop(texture))
+        texture.Release();
+}
+
+void AsyncTextureLoader::Request(int texId, const std::string& fileName)
+{
+    AsyncTexture texture;
+    texture.texId = texId;
+    texture.fileName = fileName;
+    m_requests.Push(std::move(texture));
+}
+
+void AsyncTextureLoader::Worker()
+{
+    AsyncTexture texture;
+    while (m_requests.Pop(texture))
+    {
+        // Same as VulkanRenderer::LoadTextureFile, without the throw
+        texture.pixels = LoadImageCached(texture.fileName, &texture.width, &texture.height);
+        if (texture.pixels)
+            ConvertPixels(texture.pixels, static_cast<uint32_t>(texture.width), static_cast<uint32_t>(texture.height), static_cast<size_t>(texture.width) * 4, TEXTURE_PIXEL_CONVERSIONS);
+        m_loaded.Push(std::move(texture));
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "stb_image.h"
+#include "WorkQueue.h"
+
+// Image file decoded off the render thread for CreateTextureAsync, pixels are converted RGBA8 ready for upload
+struct AsyncTexture
+{
+	int texId = -1;
+	std::string fileName;
+	stbi_uc* pixels = nullptr; // nullptr when the file couldn't be loaded
+	int width = 0;
+	int height = 0;
+
+	void Release();
+};
+
+// Background decode threads for textures requested without waiting
+// Requests go in from the render thread, finished images are polled once a frame and uploaded there
+class AsyncTextureLoader
+{
+public:
+	explicit AsyncTextureLoader(size_t threadCount);
+	~AsyncTextureLoader();
+
+	AsyncTextureLoader(const AsyncTextureLoader&) = delete;
+	AsyncTextureLoader& operator=(const AsyncTextureLoader&) = delete;
+
+	void Request(int texId, const std::string& fileName);
+
+	// Non blocking, caller uploads the pixels and calls Release
+	bool PopLoaded(AsyncTexture& texture) { return m_loaded.TryPop(texture); }
+
+private:
+	WorkQueue<AsyncTexture> m_requests;
+	WorkQueue<AsyncTexture> m_loaded;
+	std::vector<std::thread> m_workers;
+
+	void Worker();
+};
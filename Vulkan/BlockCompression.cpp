@@ -0,0 +1,340 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    uint32_t BlockBytes(TexturePackFormat format)
+    {
+        return format == TexturePackFormat::BC1 ? 8 : 16;
+    }
+
+    // 4x4 pixels starting at (bx, by), pixels past the edge repeat the last row/column
+    void FetchBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t block[16][4])
+    {
+        for (uint32_t y = 0; y < 4; y++)
+        {
+            uint32_t sy = std::min(by + y, height - 1);
+            for (uint32_t x = 0; x < 4; x++)
+            {
+                uint32_t sx = std::min(bx + x, width - 1);
+                memcpy(block[y * 4 + x], rgba + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+            }
+        }
+    }
+
+    void StoreBlock(const uint8_t block[16][4], uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t* rgba)
+    {
+        for (uint32_t y = 0; y < 4 && by + y < height; y++)
+            for (uint32_t x = 0; x < 4 && bx + x < width; x++)
+                memcpy(rgba + (static_cast<size_t>(by + y) * width + bx + x) * 4, block[y * 4 + x], 4);
+    }
+
+    uint16_t Pack565(const float color[3])
+    {
+        int r = std::clamp(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+        int g = std::clamp(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+        int b = std::clamp(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void Unpack565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // c0 > c1 gives 4 colors, otherwise 3 colors + transparent black (BC1 only, BC3 always uses 4)
+    void ColorPalette(uint16_t c0, uint16_t c1, bool fourColors, int palette[4][4])
+    {
+        Unpack565(c0, palette[0]);
+        Unpack565(c1, palette[1]);
+        palette[0][3] = palette[1][3] = 255;
+        for (int i = 0; i < 3; i++)
+        {
+            if (fourColors)
+            {
+                palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+                palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+            }
+            else
+            {
+                palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+                palette[3][i] = 0;
+            }
+        }
+        palette[2][3] = 255;
+        palette[3][3] = fourColors ? 255 : 0;
+    }
+
+    // Range fit: endpoints are the extremes of the pixels projected on the principal axis of their colors
+    // Transparent pixels (alpha < 128, BC1 only) are left out and get index 3 of the 3 color mode
+    void EncodeColorBlock(const uint8_t block[16][4], bool allowTransparent, uint8_t* output)
+    {
+        bool transparent[16];
+        bool anyTransparent = false;
+        int count = 0;
+        float mean[3] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            transparent[i] = allowTransparent && block[i][3] < 128;
+            anyTransparent |= transparent[i];
+            if (transparent[i])
+                continue;
+            for (int c = 0; c < 3; c++)
+                mean[c] += block[i][c];
+            count++;
+        }
+
+        uint16_t c0 = 0, c1 = 0;
+        if (count > 0)
+        {
+            for (int c = 0; c < 3; c++)
+                mean[c] /= count;
+
+            float cov[6] = {}; // rr rg rb gg gb bb
+            for (int i = 0; i < 16; i++)
+            {
+                if (transparent[i])
+                    continue;
+                float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+                cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+                cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+            }
+
+            // Few rounds of power iteration are plenty for a 3x3 matrix
+            float axis[3] = { 1.0f, 1.0f, 1.0f };
+            for (int iteration = 0; iteration < 8; iteration++)
+            {
+                float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+                float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+                float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+                float length = std::max({ std::fabs(x), std::fabs(y), std::fabs(z) });
+                if (length < 1e-6f)
+                    break;
+                axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+            }
+
+            float minT = 0.0f, maxT = 0.0f;
+            float lengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+            for (int i = 0; i < 16; i++)
+            {
+                if (transparent[i])
+                    continue;
+                float t = ((block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2]) / lengthSq;
+                minT = std::min(minT, t);
+                maxT = std::max(maxT, t);
+            }
+
+            float high[3], low[3];
+            for (int c = 0; c < 3; c++)
+            {
+                high[c] = mean[c] + axis[c] * maxT;
+                low[c] = mean[c] + axis[c] * minT;
+            }
+            c0 = Pack565(high);
+            c1 = Pack565(low);
+        }
+
+        // 4 color mode needs c0 > c1 and the 3 color mode c0 <= c1
+        bool fourColors = !anyTransparent;
+        if ((fourColors && c0 < c1) || (!fourColors && c0 > c1))
+            std::swap(c0, c1);
+
+        int palette[4][4];
+        ColorPalette(c0, c1, fourColors || c0 > c1, palette);
+        int usable = fourColors ? 4 : 3;
+
+        uint32_t indices = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 3;
+            if (!transparent[i])
+            {
+                // Equal endpoints in 4 color mode would decode as 3 color, index 0 is always correct there
+                int bestError = INT32_MAX;
+                for (int p = 0; p < (c0 == c1 ? 1 : usable); p++)
+                {
+                    int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+                    int error = dr * dr + dg * dg + db * db;
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+            }
+            indices |= static_cast<uint32_t>(best) << (2 * i);
+        }
+
+        memcpy(output, &c0, 2);
+        memcpy(output + 2, &c1, 2);
+        memcpy(output + 4, &indices, 4);
+    }
+
+    void DecodeColorBlock(const uint8_t* input, bool allowTransparent, uint8_t block[16][4])
+    {
+        uint16_t c0, c1;
+        uint32_t indices;
+        memcpy(&c0, input, 2);
+        memcpy(&c1, input + 2, 2);
+        memcpy(&indices, input + 4, 4);
+
+        int palette[4][4];
+        ColorPalette(c0, c1, !allowTransparent || c0 > c1, palette);
+        for (int i = 0; i < 16; i++)
+        {
+            const int* color = palette[(indices >> (2 * i)) & 3];
+            for (int c = 0; c < 4; c++)
+                block[i][c] = static_cast<uint8_t>(color[c]);
+        }
+    }
+
+    // 8 interpolated alphas between max and min, 3 bit index per pixel
+    void EncodeAlphaBlock(const uint8_t block[16][4], uint8_t* output)
+    {
+        int a0 = 0, a1 = 255;
+        for (int i = 0; i < 16; i++)
+        {
+            a0 = std::max(a0, static_cast<int>(block[i][3]));
+            a1 = std::min(a1, static_cast<int>(block[i][3]));
+        }
+
+        int palette[8] = { a0, a1 };
+        for (int i = 2; i < 8; i++)
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+
+        uint64_t indices = 0;
+        if (a0 != a1)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0;
+                int bestError = 256;
+                for (int p = 0; p < 8; p++)
+                {
+                    int error = std::abs(block[i][3] - palette[p]);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= static_cast<uint64_t>(best) << (3 * i);
+            }
+        }
+
+        output[0] = static_cast<uint8_t>(a0);
+        output[1] = static_cast<uint8_t>(a1);
+        for (int i = 0; i < 6; i++)
+            output[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+    }
+
+    void DecodeAlphaBlock(const uint8_t* input, uint8_t block[16][4])
+    {
+        int a0 = input[0], a1 = input[1];
+        int palette[8] = { a0, a1 };
+        if (a0 > a1)
+        {
+            for (int i = 2; i < 8; i++)
+                palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        }
+        else
+        {
+            for (int i = 2; i < 6; i++)
+                palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; i++)
+            indices |= static_cast<uint64_t>(input[2 + i]) << (8 * i);
+        for (int i = 0; i < 16; i++)
+            block[i][3] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+    }
+}
+
+bool IsBlockCompressed(TexturePackFormat format)
+{
+    return format != TexturePackFormat::RGBA8;
+}
+
+uint64_t TextureLevelSize(TexturePackFormat format, uint32_t width, uint32_t height)
+{
+    if (!IsBlockCompressed(format))
+        return static_cast<uint64_t>(width) * height * 4;
+    return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+uint64_t TextureChainSize(TexturePackFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    uint64_t size = 0;
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        size += TextureLevelSize(format, width, height);
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    return size;
+}
+
+bool CompressImage(TexturePackFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* output)
+{
+    if (format != TexturePackFormat::BC1 && format != TexturePackFormat::BC3)
+        return false;
+
+    uint8_t block[16][4];
+    for (uint32_t by = 0; by < height; by += 4)
+    {
+        for (uint32_t bx = 0; bx < width; bx += 4)
+        {
+            FetchBlock(rgba, width, height, bx, by, block);
+            if (format == TexturePackFormat::BC1)
+            {
+                EncodeColorBlock(block, true, output);
+                output += 8;
+            }
+            else
+            {
+                EncodeAlphaBlock(block, output);
+                EncodeColorBlock(block, false, output + 8);
+                output += 16;
+            }
+        }
+    }
+    return true;
+}
+
+bool DecompressImage(TexturePackFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba)
+{
+    if (format != TexturePackFormat::BC1 && format != TexturePackFormat::BC3)
+        return false;
+
+    uint8_t block[16][4];
+    for (uint32_t by = 0; by < height; by += 4)
+    {
+        for (uint32_t bx = 0; bx < width; bx += 4)
+        {
+            if (format == TexturePackFormat::BC1)
+            {
+                DecodeColorBlock(blocks, true, block);
+                blocks += 8;
+            }
+            else
+            {
+                DecodeColorBlock(blocks + 8, false, block);
+                DecodeAlphaBlock(blocks, block);
+                blocks += 16;
+            }
+            StoreBlock(block, width, height, bx, by, rgba);
+        }
+    }
+    return true;
+}
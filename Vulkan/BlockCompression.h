@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include "TexturePack.h"
+
+// BC1/BC3 encoder (offline, TexturePacker) and decoder (fallback for devices that can't sample them)
+// Blocks are 4x4 pixels, edge blocks repeat the last row/column of the image
+
+bool IsBlockCompressed(TexturePackFormat format);
+
+// Size of one mip level / a whole chain of levels stored back to back
+uint64_t TextureLevelSize(TexturePackFormat format, uint32_t width, uint32_t height);
+uint64_t TextureChainSize(TexturePackFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+// rgba is width * height * 4, output is TextureLevelSize bytes, only BC1 and BC3 can be encoded/decoded
+bool CompressImage(TexturePackFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* output);
+bool DecompressImage(TexturePackFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
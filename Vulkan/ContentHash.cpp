@@ -0,0 +1,112 @@
+#include "ContentHash.h"
+
+#include <cstring>
+
+namespace
+{
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+    const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+    const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+    uint64_t Rotl(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint64_t Read64(const uint8_t* data)
+    {
+        uint64_t value;
+        memcpy(&value, data, 8);
+        return value;
+    }
+
+    uint32_t Read32(const uint8_t* data)
+    {
+        uint32_t value;
+        memcpy(&value, data, 4);
+        return value;
+    }
+
+    uint64_t Round(uint64_t accumulator, uint64_t input)
+    {
+        accumulator += input * PRIME2;
+        accumulator = Rotl(accumulator, 31);
+        return accumulator * PRIME1;
+    }
+
+    uint64_t MergeRound(uint64_t hash, uint64_t accumulator)
+    {
+        hash ^= Round(0, accumulator);
+        return hash * PRIME1 + PRIME4;
+    }
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const uint8_t* input = static_cast<const uint8_t*>(data);
+    const uint8_t* end = input + size;
+    uint64_t hash;
+
+    if (size >= 32)
+    {
+        // Four independent lanes over 32 byte stripes
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        const uint8_t* limit = end - 32;
+        do
+        {
+            v1 = Round(v1, Read64(input));
+            v2 = Round(v2, Read64(input + 8));
+            v3 = Round(v3, Read64(input + 16));
+            v4 = Round(v4, Read64(input + 24));
+            input += 32;
+        } while (input <= limit);
+
+        hash = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        hash = MergeRound(hash, v1);
+        hash = MergeRound(hash, v2);
+        hash = MergeRound(hash, v3);
+        hash = MergeRound(hash, v4);
+    }
+    else
+    {
+        hash = seed + PRIME5;
+    }
+
+    hash += static_cast<uint64_t>(size);
+
+    for (; input + 8 <= end; input += 8)
+    {
+        hash ^= Round(0, Read64(input));
+        hash = Rotl(hash, 27) * PRIME1 + PRIME4;
+    }
+    if (input + 4 <= end)
+    {
+        hash ^= static_cast<uint64_t>(Read32(input)) * PRIME1;
+        hash = Rotl(hash, 23) * PRIME2 + PRIME3;
+        input += 4;
+    }
+    for (; input < end; input++)
+    {
+        hash ^= (*input) * PRIME5;
+        hash = Rotl(hash, 11) * PRIME1;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t HashTexture(const void* data, size_t size, uint32_t width, uint32_t height, uint32_t format)
+{
+    uint64_t seed = (static_cast<uint64_t>(width) << 32 | height) ^ (static_cast<uint64_t>(format) * PRIME5);
+    return HashBytes(data, size, seed);
+}
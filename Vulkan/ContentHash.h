@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// XXH64, fast non-cryptographic 64 bit hash (same output as the reference xxHash)
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// Hash of texture contents, size and format are part of the key so equal bytes of different shapes never match
+uint64_t HashTexture(const void* data, size_t size, uint32_t width, uint32_t height, uint32_t format);
@@ -0,0 +1,360 @@
+#include "DeviceAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include "Utilites.h"
+
+// Smallest size class, everything below is rounded up to it
+static const VkDeviceSize MIN_SIZE_CLASS = 256;
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static VkDeviceSize SizeClass(VkDeviceSize size, size_t* index)
+{
+    VkDeviceSize classSize = MIN_SIZE_CLASS;
+    *index = 0;
+    while (classSize < size)
+    {
+        classSize <<= 1;
+        (*index)++;
+    }
+    return classSize;
+}
+
+DeviceAllocator::DeviceAllocator(VkPhysicalDevice physicalDevice, VkDevice device)
+    : m_physicalDevice(physicalDevice), m_device(device)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+    m_bufferPools.resize(m_memoryProperties.memoryTypeCount);
+    m_imagePools.resize(m_memoryProperties.memoryTypeCount);
+}
+
+DeviceAllocator::~DeviceAllocator()
+{
+    for (auto* pools : { &m_bufferPools, &m_imagePools })
+    {
+        for (auto& pool : *pools)
+        {
+            for (auto& block : pool.blocks)
+            {
+                if (block.memory != VK_NULL_HANDLE)
+                    vkFreeMemory(m_device, block.memory, nullptr);
+            }
+        }
+    }
+}
+
+DeviceAllocation DeviceAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags propertyFlags, bool image)
+{
+    uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, propertyFlags);
+
+    if (requirements.size >= DEVICE_ALLOCATOR_DEDICATED_SIZE)
+        return AllocateDedicated(requirements.size, memoryType, image);
+
+    Pool& pool = GetPool(memoryType, image);
+
+    DeviceAllocation allocation = {};
+    allocation.memoryType = memoryType;
+    allocation.image = image;
+    allocation.size = requirements.size;
+
+    // Small buffers: reuse a freed slot of the same size class when one is suitably aligned
+    size_t classIndex = 0;
+    bool sizeClassed = !image && requirements.size <= DEVICE_ALLOCATOR_SMALL_SIZE;
+    if (sizeClassed)
+    {
+        allocation.size = SizeClass(std::max(requirements.size, requirements.alignment), &classIndex);
+        if (pool.freeSlots.size() <= classIndex)
+            pool.freeSlots.resize(classIndex + 1);
+
+        auto& slots = pool.freeSlots[classIndex];
+        for (size_t i = slots.size(); i-- > 0;)
+        {
+            if (slots[i].offset % requirements.alignment == 0)
+            {
+                allocation.block = slots[i].block;
+                allocation.offset = slots[i].offset;
+                slots[i] = slots.back();
+                slots.pop_back();
+                break;
+            }
+        }
+    }
+
+    if (allocation.block < 0)
+    {
+        for (size_t i = 0; i < pool.blocks.size(); i++)
+        {
+            if (AllocateFromBlock(pool.blocks[i], allocation.size, requirements.alignment, &allocation.offset))
+            {
+                allocation.block = static_cast<int32_t>(i);
+                break;
+            }
+        }
+    }
+
+    // Nothing fits, get a new block from the driver
+    if (allocation.block < 0)
+    {
+        Block block = {};
+        block.size = DEVICE_ALLOCATOR_BLOCK_SIZE;
+        block.freeRanges[0] = block.size;
+
+        VkMemoryAllocateInfo memoryAllocateInfo = {};
+        memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memoryAllocateInfo.allocationSize = block.size;
+        memoryAllocateInfo.memoryTypeIndex = memoryType;
+
+        if (vkAllocateMemory(m_device, &memoryAllocateInfo, nullptr, &block.memory) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate device memory block");
+
+        // Host visible blocks stay mapped, memory can't be mapped twice once it is shared
+        if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            void* mapped;
+            vkMapMemory(m_device, block.memory, 0, block.size, 0, &mapped);
+            block.mapped = static_cast<uint8_t*>(mapped);
+        }
+
+        // Block indices are kept by allocations, so released blocks leave a hole that is reused here
+        auto hole = std::find_if(pool.blocks.begin(), pool.blocks.end(), [](const Block& b) { return b.memory == VK_NULL_HANDLE; });
+        if (hole == pool.blocks.end())
+            hole = pool.blocks.insert(hole, block);
+        else
+            *hole = block;
+
+        allocation.block = static_cast<int32_t>(hole - pool.blocks.begin());
+        AllocateFromBlock(*hole, allocation.size, requirements.alignment, &allocation.offset);
+    }
+
+    Block& block = pool.blocks[allocation.block];
+    allocation.memory = block.memory;
+    allocation.mapped = block.mapped ? block.mapped + allocation.offset : nullptr;
+    m_allocationCount++;
+    return allocation;
+}
+
+void DeviceAllocator::Free(DeviceAllocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+
+    if (allocation.block < 0)
+    {
+        vkFreeMemory(m_device, allocation.memory, nullptr);
+        m_dedicatedCount--;
+        m_dedicatedBytes -= allocation.size;
+    }
+    else
+    {
+        Pool& pool = GetPool(allocation.memoryType, allocation.image);
+        Block& block = pool.blocks[allocation.block];
+
+        size_t classIndex;
+        if (!allocation.image && allocation.size <= DEVICE_ALLOCATOR_SMALL_SIZE && SizeClass(allocation.size, &classIndex) == allocation.size)
+        {
+            // Slot stays reserved in the block, next buffer of this size class takes it
+            pool.freeSlots[classIndex].push_back({ allocation.block, allocation.offset });
+        }
+        else
+        {
+            FreeToBlock(block, allocation.offset, allocation.size);
+
+            // Give empty blocks back to the driver, except the last one of a pool to avoid churn
+            size_t liveBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const Block& b) { return b.memory != VK_NULL_HANDLE; });
+            if (block.used == 0 && liveBlocks > 1)
+            {
+                vkFreeMemory(m_device, block.memory, nullptr);
+                block = {};
+            }
+        }
+    }
+
+    m_allocationCount--;
+    allocation = {};
+}
+
+DeviceAllocation DeviceAllocator::CreateBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage, VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage = bufferUsage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device, &bufferInfo, nullptr, buffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create a buffer");
+
+    VkMemoryRequirements memoryRequirements = {};
+    vkGetBufferMemoryRequirements(m_device, *buffer, &memoryRequirements);
+
+    DeviceAllocation allocation = Allocate(memoryRequirements, bufferProperties, false);
+    vkBindBufferMemory(m_device, *buffer, allocation.memory, allocation.offset);
+    return allocation;
+}
+
+DeviceAllocation DeviceAllocator::BindImage(VkImage image, VkMemoryPropertyFlags propertyFlags)
+{
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(m_device, image, &memoryRequirements);
+
+    DeviceAllocation allocation = Allocate(memoryRequirements, propertyFlags, true);
+    vkBindImageMemory(m_device, image, allocation.memory, allocation.offset);
+    return allocation;
+}
+
+void DeviceAllocator::DestroyBuffer(VkBuffer buffer, DeviceAllocation& allocation)
+{
+    vkDestroyBuffer(m_device, buffer, nullptr);
+    Free(allocation);
+}
+
+void DeviceAllocator::DestroyImage(VkImage image, DeviceAllocation& allocation)
+{
+    vkDestroyImage(m_device, image, nullptr);
+    Free(allocation);
+}
+
+DeviceAllocatorStats DeviceAllocator::GetStats() const
+{
+    DeviceAllocatorStats stats = {};
+    stats.dedicatedCount = m_dedicatedCount;
+    stats.dedicatedBytes = m_dedicatedBytes;
+    stats.allocationCount = m_allocationCount;
+
+    // Largest free range of every block summed, free space split across blocks is not fragmentation
+    VkDeviceSize largestFree = 0;
+    for (const auto* pools : { &m_bufferPools, &m_imagePools })
+    {
+        for (const auto& pool : *pools)
+        {
+            for (const auto& block : pool.blocks)
+            {
+                if (block.memory == VK_NULL_HANDLE)
+                    continue;
+
+                stats.blockCount++;
+                stats.blockBytes += block.size;
+                stats.usedBytes += block.used;
+                VkDeviceSize blockLargestFree = 0;
+                for (const auto& range : block.freeRanges)
+                {
+                    stats.freeBytes += range.second;
+                    blockLargestFree = std::max(blockLargestFree, range.second);
+                }
+                largestFree += blockLargestFree;
+            }
+
+            // Recycled slots are free for their size class only
+            VkDeviceSize classSize = MIN_SIZE_CLASS;
+            for (const auto& slots : pool.freeSlots)
+            {
+                stats.usedBytes -= classSize * slots.size();
+                stats.freeBytes += classSize * slots.size();
+                classSize <<= 1;
+            }
+        }
+    }
+
+    stats.usedBytes += m_dedicatedBytes;
+    stats.fragmentation = stats.freeBytes > 0 ? 1.0f - static_cast<float>(largestFree) / static_cast<float>(stats.freeBytes) : 0.0f;
+    return stats;
+}
+
+uint32_t DeviceAllocator::FindMemoryType(uint32_t allowedTypes, VkMemoryPropertyFlags propertyFlags) const
+{
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+    {
+        if ((allowedTypes & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags)
+            return i;
+    }
+
+    throw std::runtime_error("No memory type index");
+}
+
+DeviceAllocation DeviceAllocator::AllocateDedicated(VkDeviceSize size, uint32_t memoryType, bool image)
+{
+    DeviceAllocation allocation = {};
+    allocation.size = size;
+    allocation.memoryType = memoryType;
+    allocation.image = image;
+
+    VkMemoryAllocateInfo memoryAllocateInfo = {};
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.allocationSize = size;
+    memoryAllocateInfo.memoryTypeIndex = memoryType;
+
+    if (vkAllocateMemory(m_device, &memoryAllocateInfo, nullptr, &allocation.memory) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate dedicated device memory");
+
+    if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        void* mapped;
+        vkMapMemory(m_device, allocation.memory, 0, size, 0, &mapped);
+        allocation.mapped = static_cast<uint8_t*>(mapped);
+    }
+
+    m_dedicatedCount++;
+    m_dedicatedBytes += size;
+    m_allocationCount++;
+    return allocation;
+}
+
+bool DeviceAllocator::AllocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+{
+    // First fit, the padding in front of an aligned start stays a free range of its own
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it)
+    {
+        VkDeviceSize rangeStart = it->first;
+        VkDeviceSize rangeEnd = it->first + it->second;
+        VkDeviceSize start = AlignUp(rangeStart, alignment);
+        if (start + size > rangeEnd)
+            continue;
+
+        block.freeRanges.erase(it);
+        if (start > rangeStart)
+            block.freeRanges[rangeStart] = start - rangeStart;
+        if (start + size < rangeEnd)
+            block.freeRanges[start + size] = rangeEnd - start - size;
+
+        block.used += size;
+        *offset = start;
+        return true;
+    }
+
+    return false;
+}
+
+void DeviceAllocator::FreeToBlock(Block& block, VkDeviceSize offset, VkDeviceSize size)
+{
+    block.used -= size;
+
+    auto it = block.freeRanges.emplace(offset, size).first;
+
+    // Merge with the following range
+    auto next = std::next(it);
+    if (next != block.freeRanges.end() && offset + it->second == next->first)
+    {
+        it->second += next->second;
+        block.freeRanges.erase(next);
+    }
+
+    // Merge with the preceding range
+    if (it != block.freeRanges.begin())
+    {
+        auto previous = std::prev(it);
+        if (previous->first + previous->second == it->first)
+        {
+            previous->second += it->second;
+            block.freeRanges.erase(it);
+        }
+    }
+}
+
+DeviceAllocator::Pool& DeviceAllocator::GetPool(uint32_t memoryType, bool image)
+{
+    return image ? m_imagePools[memoryType] : m_bufferPools[memoryType];
+}
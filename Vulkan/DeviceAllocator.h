@@ -0,0 +1,97 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Piece of device memory handed out by DeviceAllocator, bind resources at memory + offset
+struct DeviceAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;        // size reserved in the block (size class for small buffers)
+	uint8_t* mapped = nullptr;    // only for host visible memory, points at offset
+	uint32_t memoryType = 0;
+	int32_t block = -1;           // -1 = dedicated allocation
+	bool image = false;
+};
+
+struct DeviceAllocatorStats
+{
+	size_t blockCount = 0;
+	size_t dedicatedCount = 0;
+	size_t allocationCount = 0;
+	VkDeviceSize blockBytes = 0;     // reserved from the driver for blocks
+	VkDeviceSize usedBytes = 0;      // handed out, blocks and dedicated
+	VkDeviceSize freeBytes = 0;      // free inside blocks
+	VkDeviceSize dedicatedBytes = 0;
+	float fragmentation = 0.0f;      // 1 - largest free range per block / free bytes, 0 = free space of every block in one piece
+};
+
+// Block based sub-allocator, one vkAllocateMemory per DEVICE_ALLOCATOR_BLOCK_SIZE instead of per resource
+// Buffers and optimal images get separate pools per memory type so bufferImageGranularity never matters
+// Small buffers are rounded up to power of two size classes and their slots are recycled through free lists
+// Resources of DEVICE_ALLOCATOR_DEDICATED_SIZE or more get their own allocation
+class DeviceAllocator
+{
+public:
+	DeviceAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+	~DeviceAllocator();
+
+	DeviceAllocator(const DeviceAllocator&) = delete;
+	DeviceAllocator& operator=(const DeviceAllocator&) = delete;
+
+	DeviceAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags propertyFlags, bool image);
+	void Free(DeviceAllocation& allocation);
+
+	// Create + allocate + bind in one go, counterparts of the free CreateBuffer and VulkanRenderer::CreateImage
+	DeviceAllocation CreateBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage, VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer);
+	DeviceAllocation BindImage(VkImage image, VkMemoryPropertyFlags propertyFlags);
+	void DestroyBuffer(VkBuffer buffer, DeviceAllocation& allocation);
+	void DestroyImage(VkImage image, DeviceAllocation& allocation);
+
+	DeviceAllocatorStats GetStats() const;
+
+private:
+	struct Block
+	{
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		VkDeviceSize used;
+		uint8_t* mapped;
+		std::map<VkDeviceSize, VkDeviceSize> freeRanges; // offset -> size, neighbours are always merged
+	};
+
+	struct Slot
+	{
+		int32_t block;
+		VkDeviceSize offset;
+	};
+
+	// One pool per memory type and resource kind
+	struct Pool
+	{
+		std::vector<Block> blocks;
+		std::vector<std::vector<Slot>> freeSlots; // per size class
+	};
+
+	VkPhysicalDevice m_physicalDevice;
+	VkDevice m_device;
+	VkPhysicalDeviceMemoryProperties m_memoryProperties;
+
+	std::vector<Pool> m_bufferPools;
+	std::vector<Pool> m_imagePools;
+
+	size_t m_allocationCount = 0;
+	size_t m_dedicatedCount = 0;
+	VkDeviceSize m_dedicatedBytes = 0;
+
+	uint32_t FindMemoryType(uint32_t allowedTypes, VkMemoryPropertyFlags propertyFlags) const;
+	DeviceAllocation AllocateDedicated(VkDeviceSize size, uint32_t memoryType, bool image);
+	bool AllocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+	void FreeToBlock(Block& block, VkDeviceSize offset, VkDeviceSize size);
+	Pool& GetPool(uint32_t memoryType, bool image);
+};
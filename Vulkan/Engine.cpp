@@ -1,6 +1,7 @@
 #include "Engine.h"
 
 std::unordered_map<unsigned long, std::weak_ptr<Mesh>> Engine::m_meshes;
+std::atomic<uint64_t> Engine::m_sceneVersion(0);
 unsigned long Engine::objectCreated = 0;
 
 void Engine::InitImGui()
@@ -85,17 +86,13 @@ bool Engine::DestroyWindow()
 
 int Engine::GetTextureId(const std::string& path)
 {
-    return m_renderer->CreateTexture(path);
+    // Called from UI code mid-frame, the placeholder shows until the file is loaded
+    return m_renderer->CreateTextureAsync(path);
 }
 
-VkQueue Engine::GetTransferQueue()
+UploadBatch& Engine::GetUploadBatch()
 {
-    return m_renderer->graphicsQueue;
-}
-
-VkCommandPool Engine::GetCommandPool()
-{
-    return m_renderer->graphicsCommandPool;
+    return m_renderer->GetUploadBatch();
 }
 
 void Engine::InitProgram(int width, int height)
@@ -123,7 +120,7 @@ std::shared_ptr<Mesh> Engine::CreateMash()
             { { .01f, .01f, 1.0f   },    { 0.0f, 0.0f, 0.0f },   {1.0f, 0.0f},   0.0f},
     };
 
-    std::shared_ptr<Mesh> visual = std::make_shared<Mesh>(m_renderer->mainDevice.physicalDevice, m_renderer->mainDevice.logicalDevice, m_renderer->graphicsQueue, m_renderer->graphicsCommandPool, &meshVertices, &MESH_INDICES, 0);
+    std::shared_ptr<Mesh> visual = std::make_shared<Mesh>(*m_renderer->deviceAllocator, m_renderer->mainDevice.logicalDevice, m_renderer->GetUploadBatch(), &meshVertices, &MESH_INDICES, 0);
     m_meshes[objectCreated++] = visual;
     return visual;
 }
@@ -185,7 +182,19 @@ void Engine::RunWindow()
             ImGui::Text("Number of objects = %u", m_meshes.size());
 
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-            ImGui::Text("Memory used: %.3f MB", m_renderer->GetDeviceMemory() / 1024.0f / 1024.0f);
+            DeviceAllocatorStats memoryStats = m_renderer->GetMemoryStats();
+            ImGui::Text("Memory used: %.3f MB", memoryStats.usedBytes / 1024.0f / 1024.0f);
+            ImGui::Text("Memory blocks: %u (%.1f MB free, %.0f%% fragmented), dedicated: %u", static_cast<unsigned>(memoryStats.blockCount), memoryStats.freeBytes / 1024.0f / 1024.0f, memoryStats.fragmentation * 100.0f, static_cast<unsigned>(memoryStats.dedicatedCount));
+            ImGui::Text("Command recording: %.3f ms on %u threads", m_renderer->GetRecordMilliseconds(), static_cast<unsigned>(m_renderer->GetRecordingThreads()));
+            if (USE_INSTANCED_SPRITES)
+                ImGui::Text("Instanced sprites%s: %u draws for %u sprites", m_renderer->spriteInstancer->IsIndirect() ? " (indirect)" : "", static_cast<unsigned>(m_renderer->spriteInstancer->GetBatches().size()), static_cast<unsigned>(m_renderer->spriteInstancer->GetSpriteCount()));
+            else if (USE_SPRITE_BATCHING)
+                ImGui::Text("Sprite batches: %u draws for %u sprites", static_cast<unsigned>(m_renderer->spriteBatcher->GetBatches().size()), static_cast<unsigned>(m_renderer->spriteBatcher->GetSpriteCount()));
+            if (const TextureResidency* residency = m_renderer->GetTextureResidency())
+            {
+                ImGui::Text("Textures resident: %.1f / %.1f MB, evicted: %u, streamed: %u", residency->GetResidentBytes() / 1024.0f / 1024.0f, residency->GetBudget() / 1024.0f / 1024.0f,
+                    static_cast<unsigned>(residency->GetEvictionCount()), static_cast<unsigned>(residency->GetStreamCount()));
+            }
         }
 
         if (ImGui::Button("Test 1"))
@@ -218,7 +227,7 @@ void Engine::CreateRenderer()
         std::cout << "Error while initializing renderer" << std::endl;
         assert(false);
     };
-    m_renderer->CreateTexture("Textures\\1px.png");
+    m_renderer->SetPlaceholderTexture(m_renderer->CreateTexture("Textures\\1px.png"));
 }
 
 void Engine::ShutdownApplication()
@@ -11,6 +11,7 @@
 #include "imgui_impl_vulkan.h"
 #include <string>
 #include "AnimationLoader.h"
+#include "UploadBatch.h"
 #include <memory>
 #include <condition_variable>
 #include <atomic>
@@ -48,9 +49,12 @@ private:
 
 	static std::unordered_map<unsigned long, std::weak_ptr<Mesh>> m_meshes;
 	static unsigned long objectCreated;
+	// Bumped by anything that changes what the scene draws (meshes made, destroyed, moved, retextured...)
+	// Scene command buffers recorded at the current version are reused as they are
+	static std::atomic<uint64_t> m_sceneVersion;
+	static void MarkSceneDirty() { m_sceneVersion++; }
 	int GetTextureId(const std::string& path);
-	VkQueue GetTransferQueue();
-	VkCommandPool GetCommandPool();
+	UploadBatch& GetUploadBatch();
 public:
 	Engine(const Engine&) = delete;
 	Engine(Engine&&) = delete;
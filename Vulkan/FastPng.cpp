@@ -0,0 +1,568 @@
+#include "FastPng.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Inflate.h"
+#include "MappedFile.h"
+#include "ScratchArena.h"
+#include "stb_image.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#include <smmintrin.h>
+#define FASTPNG_SSE2
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FASTPNG_TARGET_SSE41
+#else
+#define FASTPNG_TARGET_SSE41 __attribute__((target("sse4.1")))
+#endif
+#endif
+
+namespace
+{
+    enum Filter : uint8_t
+    {
+        FILTER_NONE = 0,
+        FILTER_SUB = 1,
+        FILTER_UP = 2,
+        FILTER_AVERAGE = 3,
+        FILTER_PAETH = 4,
+    };
+
+    enum ColorType : uint8_t
+    {
+        COLOR_GRAY = 0,
+        COLOR_RGB = 2,
+        COLOR_PALETTE = 3,
+        COLOR_GRAY_ALPHA = 4,
+        COLOR_RGBA = 6,
+    };
+
+    // Same limit as stb_image
+    const uint32_t MAX_DIMENSION = 1 << 24;
+
+    uint32_t ReadBigEndian(const uint8_t* data)
+    {
+        return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+    }
+
+    uint32_t ChunkType(const char* name)
+    {
+        return ReadBigEndian(reinterpret_cast<const uint8_t*>(name));
+    }
+
+    uint32_t ChannelCount(uint8_t colorType)
+    {
+        switch (colorType)
+        {
+        case COLOR_RGB: return 3;
+        case COLOR_GRAY_ALPHA: return 2;
+        case COLOR_RGBA: return 4;
+        default: return 1;
+        }
+    }
+
+    // Prior row of the first row is all zeros, which turns Up into None, Paeth into Sub and halves Average like the spec wants
+    // a = left, b = above, c = above left
+    uint8_t Paeth(int a, int b, int c)
+    {
+        int pa = abs(b - c);
+        int pb = abs(a - c);
+        int pc = abs(a + b - 2 * c);
+        if (pa <= pb && pa <= pc)
+            return static_cast<uint8_t>(a);
+        if (pb <= pc)
+            return static_cast<uint8_t>(b);
+        return static_cast<uint8_t>(c);
+    }
+
+    void UnfilterScalar(uint8_t filter, uint8_t* row, const uint8_t* prior, size_t rowBytes, uint32_t bpp)
+    {
+        switch (filter)
+        {
+        case FILTER_SUB:
+            for (size_t i = bpp; i < rowBytes; i++)
+                row[i] += row[i - bpp];
+            break;
+        case FILTER_UP:
+            for (size_t i = 0; i < rowBytes; i++)
+                row[i] += prior[i];
+            break;
+        case FILTER_AVERAGE:
+            for (size_t i = 0; i < bpp; i++)
+                row[i] += prior[i] >> 1;
+            for (size_t i = bpp; i < rowBytes; i++)
+                row[i] += (row[i - bpp] + prior[i]) >> 1;
+            break;
+        case FILTER_PAETH:
+            for (size_t i = 0; i < bpp; i++)
+                row[i] += prior[i];
+            for (size_t i = bpp; i < rowBytes; i++)
+                row[i] += Paeth(row[i - bpp], prior[i], prior[i - bpp]);
+            break;
+        }
+    }
+
+#ifdef FASTPNG_SSE2
+    // 3 and 4 byte pixels go through the filters one pixel per register, every pixel depends on the one to its left
+    // so there is nothing wider to do, Up has no such dependency and takes 16 bytes at a time
+    // Pixel size is a template argument, the loads and stores have to compile to single moves
+    template <uint32_t bpp>
+    __m128i LoadPixel(const uint8_t* data)
+    {
+        uint32_t value = 0;
+        memcpy(&value, data, bpp);
+        return _mm_cvtsi32_si128(static_cast<int>(value));
+    }
+
+    template <uint32_t bpp>
+    void StorePixel(uint8_t* data, __m128i pixel)
+    {
+        uint32_t value = static_cast<uint32_t>(_mm_cvtsi128_si32(pixel));
+        memcpy(data, &value, bpp);
+    }
+
+    void UnfilterUp(uint8_t* row, const uint8_t* prior, size_t rowBytes)
+    {
+        size_t i = 0;
+        for (; i + 16 <= rowBytes; i += 16)
+        {
+            __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            __m128i above = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prior + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), _mm_add_epi8(raw, above));
+        }
+        for (; i < rowBytes; i++)
+            row[i] += prior[i];
+    }
+
+    template <uint32_t bpp>
+    void UnfilterSub(uint8_t* row, size_t rowBytes)
+    {
+        __m128i left = _mm_setzero_si128();
+        for (size_t i = 0; i < rowBytes; i += bpp)
+        {
+            left = _mm_add_epi8(LoadPixel<bpp>(row + i), left);
+            StorePixel<bpp>(row + i, left);
+        }
+    }
+
+    template <uint32_t bpp>
+    void UnfilterAverage(uint8_t* row, const uint8_t* prior, size_t rowBytes)
+    {
+        // avg_epu8 rounds up, the filter rounds down
+        const __m128i one = _mm_set1_epi8(1);
+        __m128i left = _mm_setzero_si128();
+        for (size_t i = 0; i < rowBytes; i += bpp)
+        {
+            __m128i above = LoadPixel<bpp>(prior + i);
+            __m128i average = _mm_sub_epi8(_mm_avg_epu8(left, above), _mm_and_si128(_mm_xor_si128(left, above), one));
+            left = _mm_add_epi8(LoadPixel<bpp>(row + i), average);
+            StorePixel<bpp>(row + i, left);
+        }
+    }
+
+    // Distances in 16 bit lanes, ties prefer a then b like the scalar version
+    template <uint32_t bpp>
+    void UnfilterPaethSse2(uint8_t* row, const uint8_t* prior, size_t rowBytes)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i a = zero;
+        __m128i c = zero;
+        for (size_t i = 0; i < rowBytes; i += bpp)
+        {
+            __m128i b = _mm_unpacklo_epi8(LoadPixel<bpp>(prior + i), zero);
+
+            __m128i pa = _mm_sub_epi16(b, c);
+            __m128i pb = _mm_sub_epi16(a, c);
+            __m128i pc = _mm_add_epi16(pa, pb);
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+            __m128i useA = _mm_cmpeq_epi16(smallest, pa);
+            __m128i useB = _mm_andnot_si128(useA, _mm_cmpeq_epi16(smallest, pb));
+            __m128i useC = _mm_andnot_si128(_mm_or_si128(useA, useB), _mm_set1_epi16(-1));
+            __m128i predictor = _mm_or_si128(_mm_or_si128(_mm_and_si128(useA, a), _mm_and_si128(useB, b)), _mm_and_si128(useC, c));
+
+            __m128i pixel = _mm_add_epi8(LoadPixel<bpp>(row + i), _mm_packus_epi16(predictor, predictor));
+            StorePixel<bpp>(row + i, pixel);
+
+            a = _mm_unpacklo_epi8(pixel, zero);
+            c = b;
+        }
+    }
+
+    // Same with abs and blends, everything that doesn't depend on the left pixel is computed off the critical path
+    template <uint32_t bpp>
+    FASTPNG_TARGET_SSE41 void UnfilterPaethSse41(uint8_t* row, const uint8_t* prior, size_t rowBytes)
+    {
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i lowByte = _mm_set1_epi16(0xFF);
+        __m128i a = _mm_setzero_si128();
+        __m128i c = _mm_setzero_si128();
+        for (size_t i = 0; i < rowBytes; i += bpp)
+        {
+            __m128i b = _mm_cvtepu8_epi16(LoadPixel<bpp>(prior + i));
+            __m128i raw = _mm_cvtepu8_epi16(LoadPixel<bpp>(row + i));
+            __m128i bc = _mm_sub_epi16(b, c);
+            __m128i pa = _mm_abs_epi16(bc);
+
+            __m128i ac = _mm_sub_epi16(a, c);
+            __m128i pb = _mm_abs_epi16(ac);
+            __m128i pc = _mm_abs_epi16(_mm_add_epi16(ac, bc));
+
+            // c, replaced by b when it is at least as close, replaced by a when that is at least as close as both
+            __m128i nearest = _mm_min_epi16(pb, pc);
+            __m128i predictor = _mm_blendv_epi8(c, b, _mm_cmpeq_epi16(nearest, pb));
+            predictor = _mm_blendv_epi8(predictor, a, _mm_cmpgt_epi16(_mm_add_epi16(nearest, one), pa));
+
+            a = _mm_and_si128(_mm_add_epi16(raw, predictor), lowByte);
+            StorePixel<bpp>(row + i, _mm_packus_epi16(a, a));
+            c = b;
+        }
+    }
+
+    template <uint32_t bpp>
+    void UnfilterPixelsSse2(uint8_t filter, uint8_t* row, const uint8_t* prior, size_t rowBytes)
+    {
+        if (filter == FILTER_SUB)
+            UnfilterSub<bpp>(row, rowBytes);
+        else if (filter == FILTER_AVERAGE)
+            UnfilterAverage<bpp>(row, prior, rowBytes);
+        else if (filter == FILTER_PAETH)
+            UnfilterPaethSse2<bpp>(row, prior, rowBytes);
+    }
+
+    void UnfilterSse2(uint8_t filter, uint8_t* row, const uint8_t* prior, size_t rowBytes, uint32_t bpp)
+    {
+        if (filter == FILTER_UP)
+            UnfilterUp(row, prior, rowBytes);
+        else if (bpp == 4)
+            UnfilterPixelsSse2<4>(filter, row, prior, rowBytes);
+        else if (bpp == 3)
+            UnfilterPixelsSse2<3>(filter, row, prior, rowBytes);
+        else
+            UnfilterScalar(filter, row, prior, rowBytes, bpp);
+    }
+
+    void UnfilterSse41(uint8_t filter, uint8_t* row, const uint8_t* prior, size_t rowBytes, uint32_t bpp)
+    {
+        if (filter == FILTER_PAETH && bpp == 4)
+            UnfilterPaethSse41<4>(row, prior, rowBytes);
+        else if (filter == FILTER_PAETH && bpp == 3)
+            UnfilterPaethSse41<3>(row, prior, rowBytes);
+        else
+            UnfilterSse2(filter, row, prior, rowBytes, bpp);
+    }
+
+    bool CpuHasSse41()
+    {
+#ifdef _MSC_VER
+        int registers[4];
+        __cpuid(registers, 1);
+        return (registers[2] & (1 << 19)) != 0;
+#else
+        return __builtin_cpu_supports("sse4.1");
+#endif
+    }
+#endif
+
+    using UnfilterFunction = void (*)(uint8_t, uint8_t*, const uint8_t*, size_t, uint32_t);
+
+    struct UnfilterPath
+    {
+        UnfilterFunction function;
+        const char* name;
+    };
+
+    // Decided once, the first decode pays for the cpuid
+    const UnfilterPath& GetUnfilterPath()
+    {
+        static const UnfilterPath path = []() -> UnfilterPath
+        {
+#ifdef FASTPNG_SSE2
+            if (CpuHasSse41())
+                return { UnfilterSse41, "sse4.1" };
+            return { UnfilterSse2, "sse2" };
+#else
+            return { UnfilterScalar, "scalar" };
+#endif
+        }();
+        return path;
+    }
+
+    // Everything between the signature and IEND that the decoder needs
+    struct PngChunks
+    {
+        PngInfo info = {};
+        uint8_t palette[256][4] = {};
+        uint32_t paletteSize = 0;
+        bool transparent = false;
+        uint8_t transparentColor[3] = {};
+        std::vector<const uint8_t*> idat;
+        std::vector<uint32_t> idatSizes;
+    };
+
+    bool ParseChunks(const uint8_t* data, size_t size, PngChunks& chunks, bool headerOnly)
+    {
+        static const uint8_t SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        if (size < 8 + 8 + 13 || memcmp(data, SIGNATURE, 8) != 0)
+            return false;
+
+        const uint8_t* chunk = data + 8;
+        const uint8_t* end = data + size;
+        bool first = true;
+        for (;;)
+        {
+            // Length, type, data, CRC. CRCs aren't checked, stb_image doesn't either
+            if (end - chunk < 12)
+                return false;
+            uint32_t length = ReadBigEndian(chunk);
+            uint32_t type = ReadBigEndian(chunk + 4);
+            const uint8_t* body = chunk + 8;
+            if (static_cast<size_t>(end - body) < static_cast<size_t>(length) + 4)
+                return false;
+            chunk = body + length + 4;
+
+            if (first)
+            {
+                if (type != ChunkType("IHDR") || length != 13)
+                    return false;
+                first = false;
+
+                PngInfo& info = chunks.info;
+                info.width = ReadBigEndian(body);
+                info.height = ReadBigEndian(body + 4);
+                info.colorType = body[9];
+                uint8_t bitDepth = body[8];
+                uint8_t compression = body[10];
+                uint8_t filterMethod = body[11];
+                uint8_t interlace = body[12];
+
+                bool knownColor = info.colorType == COLOR_GRAY || info.colorType == COLOR_RGB || info.colorType == COLOR_PALETTE ||
+                    info.colorType == COLOR_GRAY_ALPHA || info.colorType == COLOR_RGBA;
+                if (bitDepth != 8 || !knownColor || compression || filterMethod || interlace)
+                    return false;
+                if (!info.width || !info.height || info.width > MAX_DIMENSION || info.height > MAX_DIMENSION)
+                    return false;
+                if ((1u << 30) / info.width / 4 < info.height)
+                    return false;
+
+                if (headerOnly)
+                    return true;
+            }
+            else if (type == ChunkType("PLTE"))
+            {
+                if (length > 256 * 3 || length % 3)
+                    return false;
+                chunks.paletteSize = length / 3;
+                for (uint32_t i = 0; i < chunks.paletteSize; i++)
+                {
+                    memcpy(chunks.palette[i], body + 3 * i, 3);
+                    chunks.palette[i][3] = 255;
+                }
+            }
+            else if (type == ChunkType("tRNS"))
+            {
+                if (!chunks.idat.empty())
+                    return false;
+                if (chunks.info.colorType == COLOR_PALETTE)
+                {
+                    if (!chunks.paletteSize || length > chunks.paletteSize)
+                        return false;
+                    for (uint32_t i = 0; i < length; i++)
+                        chunks.palette[i][3] = body[i];
+                }
+                else
+                {
+                    // One 16 bit sample per channel, only gray and RGB may have it
+                    uint32_t channels = ChannelCount(chunks.info.colorType);
+                    if (channels % 2 == 0 || length != channels * 2)
+                        return false;
+                    chunks.transparent = true;
+                    for (uint32_t i = 0; i < channels; i++)
+                        chunks.transparentColor[i] = body[2 * i + 1];
+                }
+            }
+            else if (type == ChunkType("IDAT"))
+            {
+                if (chunks.info.colorType == COLOR_PALETTE && !chunks.paletteSize)
+                    return false;
+                chunks.idat.push_back(body);
+                chunks.idatSizes.push_back(length);
+            }
+            else if (type == ChunkType("IEND"))
+            {
+                return !chunks.idat.empty();
+            }
+            else if (type == ChunkType("CgBI") || !(type & (1 << 29)))
+            {
+                // Apple's premultiplied BGR variant and unknown critical chunks are left to stb
+                return false;
+            }
+        }
+    }
+
+    // One unfiltered row to RGBA8, with the conversions stb_image does for STBI_rgb_alpha
+    void ExpandRow(const PngChunks& chunks, const uint8_t* src, uint8_t* dst)
+    {
+        uint32_t width = chunks.info.width;
+        const uint8_t* key = chunks.transparentColor;
+        switch (chunks.info.colorType)
+        {
+        case COLOR_RGBA:
+            memcpy(dst, src, static_cast<size_t>(width) * 4);
+            break;
+        case COLOR_RGB:
+            for (uint32_t x = 0; x < width; x++, src += 3, dst += 4)
+            {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+                dst[3] = chunks.transparent && src[0] == key[0] && src[1] == key[1] && src[2] == key[2] ? 0 : 255;
+            }
+            break;
+        case COLOR_PALETTE:
+            for (uint32_t x = 0; x < width; x++, dst += 4)
+                memcpy(dst, chunks.palette[src[x]], 4);
+            break;
+        case COLOR_GRAY_ALPHA:
+            for (uint32_t x = 0; x < width; x++, src += 2, dst += 4)
+            {
+                dst[0] = dst[1] = dst[2] = src[0];
+                dst[3] = src[1];
+            }
+            break;
+        case COLOR_GRAY:
+            for (uint32_t x = 0; x < width; x++, dst += 4)
+            {
+                dst[0] = dst[1] = dst[2] = src[x];
+                dst[3] = chunks.transparent && src[x] == key[0] ? 0 : 255;
+            }
+            break;
+        }
+    }
+}
+
+bool ReadPngInfo(const uint8_t* data, size_t size, PngInfo* info)
+{
+    PngChunks chunks;
+    if (!ParseChunks(data, size, chunks, true))
+        return false;
+    *info = chunks.info;
+    return true;
+}
+
+bool DecodePng(const uint8_t* data, size_t size, uint8_t* dst, size_t dstStride)
+{
+    PngChunks chunks;
+    if (!ParseChunks(data, size, chunks, false))
+        return false;
+
+    // Image sized scratch comes from the thread's arena, no malloc/free per image once a loader thread is warmed up
+    ScratchArena& arena = ScratchArena::ForThread();
+    ScratchArena::Scope scope(arena);
+
+    // Image data split over several IDAT chunks is one zlib stream, inflate wants it in one piece
+    const uint8_t* compressed = chunks.idat[0];
+    size_t compressedSize = chunks.idatSizes[0];
+    if (chunks.idat.size() > 1)
+    {
+        compressedSize = 0;
+        for (uint32_t size : chunks.idatSizes)
+            compressedSize += size;
+
+        uint8_t* joined = arena.Allocate(compressedSize);
+        compressed = joined;
+        for (size_t i = 0; i < chunks.idat.size(); i++)
+        {
+            memcpy(joined, chunks.idat[i], chunks.idatSizes[i]);
+            joined += chunks.idatSizes[i];
+        }
+    }
+
+    // Every row is a filter type byte and the filtered pixels
+    const PngInfo& info = chunks.info;
+    uint32_t bpp = ChannelCount(info.colorType);
+    size_t rowBytes = static_cast<size_t>(info.width) * bpp;
+    size_t filteredSize = info.height * (rowBytes + 1);
+    uint8_t* filtered = arena.Allocate(filteredSize);
+    if (!ZlibInflate(compressed, compressedSize, filtered, filteredSize))
+        return false;
+
+    UnfilterFunction unfilter = GetUnfilterPath().function;
+    uint8_t* zeroRow = arena.Allocate(rowBytes);
+    memset(zeroRow, 0, rowBytes);
+    const uint8_t* prior = zeroRow;
+    for (uint32_t y = 0; y < info.height; y++)
+    {
+        uint8_t* row = filtered + y * (rowBytes + 1);
+        uint8_t filter = row[0];
+        if (filter > FILTER_PAETH)
+            return false;
+
+        unfilter(filter, row + 1, prior, rowBytes, bpp);
+        ExpandRow(chunks, row + 1, dst + y * dstStride);
+        prior = row + 1;
+    }
+    return true;
+}
+
+uint8_t* LoadPngFile(const std::string& fileName, int* width, int* height)
+{
+    MappedFile file;
+    if (!file.Open(fileName))
+        return nullptr;
+
+    PngInfo info;
+    if (ReadPngInfo(file.Data(), file.Size(), &info))
+    {
+        uint8_t* pixels = static_cast<uint8_t*>(malloc(static_cast<size_t>(info.width) * info.height * 4));
+        if (pixels && DecodePng(file.Data(), file.Size(), pixels, static_cast<size_t>(info.width) * 4))
+        {
+            *width = static_cast<int>(info.width);
+            *height = static_cast<int>(info.height);
+            return pixels;
+        }
+        free(pixels);
+    }
+
+    int channels;
+    return stbi_load_from_memory(file.Data(), static_cast<int>(file.Size()), width, height, &channels, STBI_rgb_alpha);
+}
+
+bool LoadPngFileInto(const std::string& fileName, uint32_t width, uint32_t height, uint8_t* dst, size_t dstStride)
+{
+    MappedFile file;
+    if (!file.Open(fileName))
+        return false;
+
+    PngInfo info;
+    if (ReadPngInfo(file.Data(), file.Size(), &info))
+    {
+        if (info.width != width || info.height != height)
+            return false;
+        if (DecodePng(file.Data(), file.Size(), dst, dstStride))
+            return true;
+    }
+
+    // stb only decodes into its own buffer, one extra copy for the files FastPng doesn't take or fails on
+    int channels, stbWidth, stbHeight;
+    stbi_uc* pixels = stbi_load_from_memory(file.Data(), static_cast<int>(file.Size()), &stbWidth, &stbHeight, &channels, STBI_rgb_alpha);
+    bool matches = pixels && static_cast<uint32_t>(stbWidth) == width && static_cast<uint32_t>(stbHeight) == height;
+    if (matches)
+    {
+        for (uint32_t y = 0; y < height; y++)
+            memcpy(dst + y * dstStride, pixels + static_cast<size_t>(y) * width * 4, static_cast<size_t>(width) * 4);
+    }
+    stbi_image_free(pixels);
+    return matches;
+}
+
+const char* GetPngUnfilterPath()
+{
+    return GetUnfilterPath().name;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// PNG decoder for what textures actually are: 8 bit gray, gray + alpha, RGB, RGBA or palette, not interlaced
+// Output is RGBA8 byte for byte the same as stbi_load(..., STBI_rgb_alpha), everything else (16 bit, interlaced,
+// 1/2/4 bit palettes, broken files...) is refused and callers fall back to stb
+// Inflate is the one in Inflate.h, unfiltering runs SSE2 or SSE4.1 depending on the CPU, scalar elsewhere
+// Scratch memory comes from the calling thread's ScratchArena
+struct PngInfo
+{
+	uint32_t width;
+	uint32_t height;
+	uint8_t colorType;
+};
+
+// Only looks at the signature and IHDR, false when DecodePng would refuse the file for its format
+bool ReadPngInfo(const uint8_t* data, size_t size, PngInfo* info);
+// Writes height rows of width * 4 bytes, dstStride apart
+bool DecodePng(const uint8_t* data, size_t size, uint8_t* dst, size_t dstStride);
+
+// stbi_load(..., STBI_rgb_alpha) replacement, malloc'ed like stb so stbi_image_free releases it either way
+uint8_t* LoadPngFile(const std::string& fileName, int* width, int* height);
+// Same into caller memory (e.g. mapped staging), false if the file isn't width x height
+// Files FastPng refuses are decoded by stb and copied over
+bool LoadPngFileInto(const std::string& fileName, uint32_t width, uint32_t height, uint8_t* dst, size_t dstStride);
+
+// Unfilter implementation picked for this CPU: "scalar", "sse2" or "sse4.1"
+const char* GetPngUnfilterPath();
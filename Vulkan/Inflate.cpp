@@ -0,0 +1,350 @@
+#include "Inflate.h"
+
+#include <cstring>
+
+namespace
+{
+    const int FAST_BITS = 10;
+    const uint32_t FAST_MASK = (1u << FAST_BITS) - 1;
+
+    const uint16_t LENGTH_BASE[31] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258, 0, 0 };
+    const uint8_t LENGTH_EXTRA[31] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0, 0, 0 };
+    const uint16_t DIST_BASE[32] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577, 0, 0 };
+    const uint8_t DIST_EXTRA[32] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 0, 0 };
+
+    // Canonical Huffman code, codes up to FAST_BITS long resolve with one lookup, longer ones walk the lengths
+    struct Huffman
+    {
+        uint16_t fast[1 << FAST_BITS]; // (length << 9) | symbol, 0 = longer code
+        uint16_t firstCode[16];
+        uint16_t firstSymbol[16];
+        uint32_t maxCode[17];          // preshifted to 16 bits
+        uint8_t size[288];
+        uint16_t value[288];
+    };
+
+    uint32_t ReverseBits(uint32_t value, int bits)
+    {
+        value = ((value & 0xAAAA) >> 1) | ((value & 0x5555) << 1);
+        value = ((value & 0xCCCC) >> 2) | ((value & 0x3333) << 2);
+        value = ((value & 0xF0F0) >> 4) | ((value & 0x0F0F) << 4);
+        value = ((value & 0xFF00) >> 8) | ((value & 0x00FF) << 8);
+        return value >> (16 - bits);
+    }
+
+    bool BuildHuffman(Huffman& huffman, const uint8_t* lengths, int count)
+    {
+        int sizes[17] = {};
+        memset(huffman.fast, 0, sizeof(huffman.fast));
+        for (int i = 0; i < count; i++)
+            sizes[lengths[i]]++;
+        sizes[0] = 0;
+        for (int i = 1; i < 16; i++)
+            if (sizes[i] > (1 << i))
+                return false;
+
+        int nextCode[16];
+        int code = 0;
+        int symbols = 0;
+        for (int i = 1; i < 16; i++)
+        {
+            nextCode[i] = code;
+            huffman.firstCode[i] = static_cast<uint16_t>(code);
+            huffman.firstSymbol[i] = static_cast<uint16_t>(symbols);
+            code += sizes[i];
+            if (sizes[i] && code - 1 >= (1 << i))
+                return false;
+            huffman.maxCode[i] = static_cast<uint32_t>(code) << (16 - i);
+            code <<= 1;
+            symbols += sizes[i];
+        }
+        huffman.maxCode[16] = 0x10000;
+
+        for (int i = 0; i < count; i++)
+        {
+            int length = lengths[i];
+            if (!length)
+                continue;
+
+            int slot = nextCode[length] - huffman.firstCode[length] + huffman.firstSymbol[length];
+            huffman.size[slot] = static_cast<uint8_t>(length);
+            huffman.value[slot] = static_cast<uint16_t>(i);
+            if (length <= FAST_BITS)
+            {
+                uint16_t entry = static_cast<uint16_t>((length << 9) | i);
+                for (uint32_t j = ReverseBits(nextCode[length], length); j < (1u << FAST_BITS); j += 1u << length)
+                    huffman.fast[j] = entry;
+            }
+            nextCode[length]++;
+        }
+        return true;
+    }
+
+    class BitReader
+    {
+    public:
+        BitReader(const uint8_t* data, size_t size) : m_data(data), m_end(data + size) {}
+
+        // At least 56 bits in the buffer afterwards, past the end of the input reads zeros
+        void Refill()
+        {
+            if (m_end - m_data >= 8)
+            {
+                uint64_t value;
+                memcpy(&value, m_data, 8);
+                m_buffer |= value << m_count;
+                m_data += (63 - m_count) >> 3;
+                m_count |= 56;
+                return;
+            }
+            while (m_count <= 56)
+            {
+                if (m_data < m_end)
+                    m_buffer |= static_cast<uint64_t>(*m_data++) << m_count;
+                else
+                    m_overrun += 8;
+                m_count += 8;
+            }
+        }
+
+        uint32_t Peek(int bits) const { return static_cast<uint32_t>(m_buffer & ((1ull << bits) - 1)); }
+        void Consume(int bits) { m_buffer >>= bits; m_count -= bits; }
+
+        uint32_t Read(int bits)
+        {
+            if (m_count < bits)
+                Refill();
+            uint32_t value = Peek(bits);
+            Consume(bits);
+            return value;
+        }
+
+        // Stored blocks start on a byte boundary and are copied straight from the input
+        void AlignToByte() { Consume(m_count & 7); }
+        bool ReadBytes(uint8_t* dst, size_t size)
+        {
+            // Whole bytes still sitting in the bit buffer go first
+            while (size && m_count >= 8)
+            {
+                *dst++ = static_cast<uint8_t>(Read(8));
+                size--;
+            }
+            if (!size)
+                return true;
+            if (static_cast<size_t>(m_end - m_data) < size)
+                return false;
+            memcpy(dst, m_data, size);
+            m_data += size;
+            // Refill leaves copies of upcoming bytes above m_count, they are stale after skipping ahead
+            m_buffer = 0;
+            return true;
+        }
+
+        // Reading zeros past the end is fine while decoding, using them is not
+        bool Overrun() const { return m_overrun > m_count; }
+        // Input bytes still to come, not counting those zeros
+        size_t Remaining() const { return (m_count > m_overrun ? (m_count - m_overrun) / 8 : 0) + static_cast<size_t>(m_end - m_data); }
+
+        int Decode(const Huffman& huffman)
+        {
+            if (m_count < 16)
+                Refill();
+
+            uint16_t entry = huffman.fast[m_buffer & FAST_MASK];
+            if (entry)
+            {
+                Consume(entry >> 9);
+                return entry & 511;
+            }
+
+            uint32_t code = ReverseBits(static_cast<uint32_t>(m_buffer & 0xFFFF), 16);
+            int length = FAST_BITS + 1;
+            while (code >= huffman.maxCode[length])
+                length++;
+            if (length >= 16)
+                return -1;
+
+            int slot = (code >> (16 - length)) - huffman.firstCode[length] + huffman.firstSymbol[length];
+            if (slot >= 288 || huffman.size[slot] != length)
+                return -1;
+            Consume(length);
+            return huffman.value[slot];
+        }
+
+    private:
+        const uint8_t* m_data;
+        const uint8_t* m_end;
+        uint64_t m_buffer = 0;
+        int m_count = 0;
+        int m_overrun = 0;
+    };
+
+    bool ReadDynamicTables(BitReader& bits, Huffman& literals, Huffman& distances)
+    {
+        static const uint8_t ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        int literalCount = bits.Read(5) + 257;
+        int distanceCount = bits.Read(5) + 1;
+        int codeLengthCount = bits.Read(4) + 4;
+
+        uint8_t codeLengths[19] = {};
+        for (int i = 0; i < codeLengthCount; i++)
+            codeLengths[ORDER[i]] = static_cast<uint8_t>(bits.Read(3));
+
+        Huffman codeLengthHuffman;
+        if (!BuildHuffman(codeLengthHuffman, codeLengths, 19))
+            return false;
+
+        uint8_t lengths[286 + 32];
+        int total = literalCount + distanceCount;
+        int filled = 0;
+        while (filled < total)
+        {
+            int symbol = bits.Decode(codeLengthHuffman);
+            if (symbol < 0)
+                return false;
+
+            if (symbol < 16)
+            {
+                lengths[filled++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            uint8_t fill = 0;
+            int repeat;
+            if (symbol == 16)
+            {
+                if (filled == 0)
+                    return false;
+                repeat = bits.Read(2) + 3;
+                fill = lengths[filled - 1];
+            }
+            else if (symbol == 17)
+                repeat = bits.Read(3) + 3;
+            else
+                repeat = bits.Read(7) + 11;
+
+            if (total - filled < repeat)
+                return false;
+            memset(lengths + filled, fill, repeat);
+            filled += repeat;
+        }
+
+        return BuildHuffman(literals, lengths, literalCount) && BuildHuffman(distances, lengths + literalCount, distanceCount);
+    }
+
+    bool BuildFixedTables(Huffman& literals, Huffman& distances)
+    {
+        uint8_t lengths[288];
+        memset(lengths, 8, 144);
+        memset(lengths + 144, 9, 112);
+        memset(lengths + 256, 7, 24);
+        memset(lengths + 280, 8, 8);
+
+        uint8_t distanceLengths[32];
+        memset(distanceLengths, 5, 32);
+        return BuildHuffman(literals, lengths, 288) && BuildHuffman(distances, distanceLengths, 32);
+    }
+
+    bool InflateBlock(BitReader& bits, const Huffman& literals, const Huffman& distances, uint8_t* dst, uint8_t*& out, uint8_t* end)
+    {
+        for (;;)
+        {
+            int symbol = bits.Decode(literals);
+            if (symbol < 256)
+            {
+                if (symbol < 0 || out == end)
+                    return false;
+                *out++ = static_cast<uint8_t>(symbol);
+                continue;
+            }
+            if (symbol == 256)
+                return !bits.Overrun();
+
+            symbol -= 257;
+            if (symbol >= 29)
+                return false;
+            uint32_t length = LENGTH_BASE[symbol] + bits.Read(LENGTH_EXTRA[symbol]);
+
+            int distanceSymbol = bits.Decode(distances);
+            if (distanceSymbol < 0 || distanceSymbol >= 30)
+                return false;
+            uint32_t distance = DIST_BASE[distanceSymbol] + bits.Read(DIST_EXTRA[distanceSymbol]);
+
+            if (distance > static_cast<size_t>(out - dst) || length > static_cast<size_t>(end - out))
+                return false;
+
+            const uint8_t* from = out - distance;
+            if (distance >= 8 && end - out >= static_cast<ptrdiff_t>(length) + 8)
+            {
+                // 8 byte chunks never read bytes this copy hasn't written yet, overshoot lands in space written later
+                uint8_t* target = out + length;
+                do
+                {
+                    memcpy(out, from, 8);
+                    out += 8;
+                    from += 8;
+                } while (out < target);
+                out = target;
+            }
+            else if (distance == 1)
+            {
+                memset(out, *from, length);
+                out += length;
+            }
+            else
+            {
+                for (uint32_t i = 0; i < length; i++)
+                    *out++ = *from++;
+            }
+        }
+    }
+}
+
+bool ZlibInflate(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+    if (srcSize < 2)
+        return false;
+
+    // CMF/FLG: deflate, no preset dictionary, header checksum
+    if ((src[0] & 15) != 8 || (src[1] & 32) || ((src[0] << 8) | src[1]) % 31 != 0)
+        return false;
+
+    BitReader bits(src + 2, srcSize - 2);
+    uint8_t* out = dst;
+    uint8_t* end = dst + dstSize;
+
+    Huffman literals;
+    Huffman distances;
+    bool last = false;
+    while (!last)
+    {
+        last = bits.Read(1) != 0;
+        uint32_t type = bits.Read(2);
+
+        if (type == 0)
+        {
+            bits.AlignToByte();
+            uint32_t length = bits.Read(16);
+            uint32_t inverse = bits.Read(16);
+            if ((length ^ 0xFFFF) != inverse || length > static_cast<size_t>(end - out) || length > bits.Remaining())
+                return false;
+            if (!bits.ReadBytes(out, length))
+                return false;
+            out += length;
+        }
+        else if (type == 1 || type == 2)
+        {
+            bool built = type == 1 ? BuildFixedTables(literals, distances) : ReadDynamicTables(bits, literals, distances);
+            if (!built || !InflateBlock(bits, literals, distances, dst, out, end))
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // Adler32 is not checked, stb_image doesn't either and the output has to match it
+    return out == end;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// zlib (RFC 1950/1951) decoder for buffers whose decompressed size is known up front, like PNG image data
+// 64 bit bit buffer, 10 bit lookup tables for Huffman codes and 8 byte match copies where they can't overlap
+// Returns false on corrupt data or when the stream doesn't produce exactly dstSize bytes
+bool ZlibInflate(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
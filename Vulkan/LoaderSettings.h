@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "PixelConvert.h"
+
+// Decode animation frames on worker threads, upload from the loading thread
+const bool USE_THREAD_LOADING = true;
+
+// Number of decode workers, 0 = one per hardware thread
+const size_t NUMBER_OF_THREADS = 0;
+
+// Background threads decoding CreateTextureAsync requests
+const size_t ASYNC_TEXTURE_THREADS = 2;
+
+// Max decoded images waiting for upload (bounds staging memory held by the loader)
+const size_t DECODE_QUEUE_CAPACITY = 64;
+
+// Keep decoded RGBA8 of every loaded image file in TEXTURE_CACHE_DIRECTORY, later runs read it back instead of decoding
+// Entries are invalidated by file size/modification time, oldest read ones are deleted past TEXTURE_CACHE_MAX_SIZE
+const bool USE_TEXTURE_CACHE = true;
+const char* const TEXTURE_CACHE_DIRECTORY = "TextureCache";
+const uint64_t TEXTURE_CACHE_MAX_SIZE = 4ull * 1024 * 1024 * 1024;
+
+// Decode 8 bit PNGs with FastPng (own inflate, SIMD unfilter picked by CPU), other files and PNG flavours still go to stb_image
+const bool USE_FAST_PNG = true;
+
+// Conversions (PixelConversion bits) the loader threads run on every decoded image before upload
+// Premultiplied alpha lets the pipeline blend with ONE / ONE_MINUS_SRC_ALPHA, packs made with other conversions are skipped
+const uint32_t TEXTURE_PIXEL_CONVERSIONS = PIXEL_PREMULTIPLY;
+
+// Hash decoded frames on the loader threads and reuse the texture of byte identical frames (holds, loops)
+const bool USE_TEXTURE_DEDUPE = true;
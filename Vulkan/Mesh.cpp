@@ -3,20 +3,30 @@
 #include <stdio.h>
 #include <string.h>
 
-Mesh::Mesh(VkPhysicalDevice device, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int texId = -1)
+Mesh::Mesh(DeviceAllocator& allocator, VkDevice newDevice, UploadBatch& uploadBatch, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int texId = -1)
 {
 	indexCount = indices->size();
 	vertexCount = vertices->size();
-	physicalDevice = device;
+	this->allocator = &allocator;
 	this->device = newDevice;
-	CreateVertexBuffer(transferQueue, transferCommandPool, vertices);
-	CreateIndexBuffer(transferQueue, transferCommandPool, indices);
+
+	// Both copies go into the caller's batch, or are submitted together here when there is none open
+	uploadBatch.Begin();
+	CreateVertexBuffer(uploadBatch, vertices);
+	CreateIndexBuffer(uploadBatch, indices);
+	uploadBatch.End();
 	model.m_model = glm::mat4(1.0f);
 	posX = vertices[0][0].m_position.x;
 	posY = vertices[0][0].m_position.y;
 	width = vertices[0][3].m_position.x - vertices[0][0].m_position.x;
 	height = vertices[0][0].m_position.y - vertices[0][1].m_position.y;
 	textureId = texId;
+	Engine::MarkSceneDirty();
+}
+
+Mesh::~Mesh()
+{
+	Engine::MarkSceneDirty();
 }
 
 int Mesh::GetVertexCount()
@@ -33,11 +43,8 @@ VkBuffer Mesh::GetVertexBuffer() const
 
 void Mesh::DestroyBuffer()
 {
-	vkDestroyBuffer(device, vertexBuffer, nullptr);
-	vkFreeMemory(device, vertexBufferMemory, nullptr);
-
-	vkDestroyBuffer(device, indexBuffer, nullptr);
-	vkFreeMemory(device, indexBufferMemory, nullptr);
+	allocator->DestroyBuffer(vertexBuffer, vertexBufferMemory);
+	allocator->DestroyBuffer(indexBuffer, indexBufferMemory);
 }
 
 // width, height
@@ -48,6 +55,7 @@ void Mesh::SetMeshSize(const std::pair<float, float>& size)
 	model.m_model = glm::scale(model.m_model, glm::vec3(width,height, 1.0f));
 	width = size.first;
 	height = size.second;
+	Engine::MarkSceneDirty();
 
 }
 
@@ -58,6 +66,19 @@ void Mesh::SetMeshPosition(const std::pair<float, float>& position)
 	model.m_model = glm::translate(model.m_model, glm::vec3(posX, posY, 0.0f));
 	posX = position.first;
 	posY = position.second;
+	Engine::MarkSceneDirty();
+}
+
+void Mesh::SetModel(glm::mat4 model)
+{
+	this->model.m_model = model;
+	Engine::MarkSceneDirty();
+}
+
+void Mesh::SetTextureLayer(int layer)
+{
+	model.m_textureLayer = layer;
+	Engine::MarkSceneDirty();
 }
 
 void Mesh::AddVisual(const std::shared_ptr<Mesh>& visual)
@@ -80,65 +101,41 @@ void Mesh::SetTexture(const std::string& texturePath)
 
 	int texId = Engine::GetInstance().GetTextureId(texturePath);
 	this->textureId = texId;
-
-	CreateVertexBuffer(Engine::GetInstance().GetTransferQueue(), Engine::GetInstance().GetCommandPool(), &meshVertices);
-	CreateIndexBuffer(Engine::GetInstance().GetTransferQueue(), Engine::GetInstance().GetCommandPool(), &MESH_INDICES);
+	model.m_textureLayer = 0;
+
+	UploadBatch& uploadBatch = Engine::GetInstance().GetUploadBatch();
+	uploadBatch.Begin();
+	CreateVertexBuffer(uploadBatch, &meshVertices);
+	CreateIndexBuffer(uploadBatch, &MESH_INDICES);
+	uploadBatch.End();
+	Engine::MarkSceneDirty();
 }
 
-void Mesh::CreateVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices)
+void Mesh::CreateVertexBuffer(UploadBatch& uploadBatch, std::vector<Vertex>* vertices)
 {
-	
 	VkDeviceSize bufferSize = sizeof(Vertex) * vertices->size();
-	
-	// Temporary buffer to stage vertex data before transfering to GPU
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	
-	CreateBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
-
-	// MAP MEMORY TO VERTEX BUFFER
-	void* data;														               // 1. Create pointer to a point in memory
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);              // 2. "MAP" the vertex buffer memory to that point
-	memcpy(data, vertices->data(), static_cast<size_t>(bufferSize));               // 3. Copy memory from vertices vector to the point
-	vkUnmapMemory(device, stagingBufferMemory);                                     // Unmap the vertex buffer memory
 
 	// Create buffer with TRANSFER_DST_BIT to mark as recipient of transfer data (also Vertex buffer)
 	// Buffer memory is to be DEVICE_LOCAL_BIT meaning memory is on the GPU and only accessible by it and not CPU (host)
-	CreateBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &vertexBuffer, &vertexBufferMemory);
+	// Sub-allocated, a few thousand meshes share a handful of memory blocks
+	vertexBufferMemory = allocator->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &vertexBuffer);
 
-	// Copy staging buffer to vertex buffer on GPU
-	CopyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, vertexBuffer, bufferSize);
-
-	// Clean up staging buffer parts
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	// Vertices are staged by the batch and copied on its next submit
+	uploadBatch.EnqueueBufferCopy(vertices->data(), bufferSize, vertexBuffer);
+	m_vertices = *vertices;
 }
 
 
 
-void Mesh::CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices)
+void Mesh::CreateIndexBuffer(UploadBatch& uploadBatch, std::vector<uint32_t>* indices)
 {
 	// Get size of buffer needed for indices
 	VkDeviceSize bufferSize = sizeof(uint32_t) * indices->size();
 
-	// Temporary buffer to stage vertex data before transfering to GPU
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices->data(), static_cast<size_t>(bufferSize));
-	vkUnmapMemory(device, stagingBufferMemory);
-
 	// Create buffer for INDEX data on GPU access only area
-	CreateBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indexBuffer, &indexBufferMemory);
-
-	// Copy from staging buffer to GPU acces buffer
-	CopyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, indexBuffer, bufferSize);
+	indexBufferMemory = allocator->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indexBuffer);
 
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	uploadBatch.EnqueueBufferCopy(indices->data(), bufferSize, indexBuffer);
+	m_indices = *indices;
 }
\ No newline at end of file
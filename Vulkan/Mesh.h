@@ -11,18 +11,23 @@
 #include "glm/gtc/type_ptr.hpp"
 #include <memory>
 #include "Engine.h"
+#include "UploadBatch.h"
+#include "DeviceAllocator.h"
 
+// Pushed as push constant, layout must match PushModel in shader.vert
 struct Model
 {
 	glm::mat4 m_model;
+	int m_textureLayer = 0; // layer of the texture array to sample
+	int m_textureIndex = 0; // element of the bindless texture array, set when the draw is recorded
 };
 
 class Mesh : public std::enable_shared_from_this<Mesh>
 {
 public:
-	Mesh(VkPhysicalDevice device, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex> * vertices, std::vector<uint32_t>* indices, int texId);
+	Mesh(DeviceAllocator& allocator, VkDevice newDevice, UploadBatch& uploadBatch, std::vector<Vertex> * vertices, std::vector<uint32_t>* indices, int texId);
 	Mesh() {};
-	~Mesh() {};
+	~Mesh();
 	int GetVertexCount();
 
 	VkBuffer GetVertexBuffer() const;
@@ -32,16 +37,24 @@ public:
 
 	int GetIndexCount() { return indexCount; };
 	VkBuffer GetIndexBuffer() const { return indexBuffer; };
+	// Copies of what the buffers hold, the sprite batcher reads these
+	const std::vector<Vertex>& GetVertices() const { return m_vertices; }
+	const std::vector<uint32_t>& GetIndices() const { return m_indices; }
 
-	void SetModel(glm::mat4 model) { this->model.m_model = model; };
-	Model& GetModel() { return model; };
+	// Setters mark the scene dirty, so recorded scene command buffers pick the change up
+	void SetModel(glm::mat4 model);
+	const Model& GetModel() const { return model; };
 	inline int GetTexId() const { return textureId; }
+	void SetTextureLayer(int layer);
+	inline int GetTextureLayer() const { return model.m_textureLayer; }
 	void AddVisual(const std::shared_ptr<Mesh>& visual);
 	void SetTexture(const std::string& texturePath);
 
 private:
 	std::weak_ptr<Mesh> m_parent;
 	std::vector<std::weak_ptr<Mesh>> m_children;
+	std::vector<Vertex> m_vertices;
+	std::vector<uint32_t> m_indices;
 	bool m_visible;
 	Model model;
 	float posX, posY;
@@ -49,13 +62,13 @@ private:
 	int textureId;
 	int vertexCount;
 	VkBuffer vertexBuffer;
-	VkPhysicalDevice physicalDevice;
-	VkDeviceMemory vertexBufferMemory;
+	DeviceAllocator* allocator;
+	DeviceAllocation vertexBufferMemory;
 	VkDevice device;
 	int indexCount;
 	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
-	void CreateVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices);
-	void CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices);
+	DeviceAllocation indexBufferMemory;
+	void CreateVertexBuffer(UploadBatch& uploadBatch, std::vector<Vertex>* vertices);
+	void CreateIndexBuffer(UploadBatch& uploadBatch, std::vector<uint32_t>* indices);
 };
 
@@ -0,0 +1,80 @@
+#include "MipMaps.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIPMAPS_SSE2
+#endif
+
+uint32_t MipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        levels++;
+    return levels;
+}
+
+void DownsampleBox(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst)
+{
+    uint32_t dstWidth = std::max(1u, srcWidth / 2);
+    uint32_t dstHeight = std::max(1u, srcHeight / 2);
+
+    for (uint32_t y = 0; y < dstHeight; y++)
+    {
+        const uint8_t* row0 = src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+        const uint8_t* row1 = src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+        uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+        uint32_t x = 0;
+#ifdef MIPMAPS_SSE2
+        // 4 source pixels of both rows -> 2 destination pixels, sums in 16 bit so rounding matches the scalar path
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for (; 2 * x + 4 <= srcWidth && x + 2 <= dstWidth; x += 2)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+
+            __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));   // pixels 0,1
+            __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));  // pixels 2,3
+
+            __m128i even = _mm_unpacklo_epi64(low, high);
+            __m128i odd = _mm_unpackhi_epi64(low, high);
+            __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(even, odd), two), 2);
+
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4 * x), _mm_packus_epi16(sum, sum));
+        }
+#endif
+        for (; x < dstWidth; x++)
+        {
+            uint32_t x0 = std::min(2 * x, srcWidth - 1) * 4;
+            uint32_t x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+            for (uint32_t c = 0; c < 4; c++)
+                out[4 * x + c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+        }
+    }
+}
+
+std::vector<uint8_t> GenerateMipChain(const uint8_t* base, uint32_t width, uint32_t height, uint32_t mipLevels, std::vector<size_t>* offsets)
+{
+    offsets->clear();
+
+    size_t total = 0;
+    for (uint32_t level = 1; level < mipLevels; level++)
+    {
+        offsets->push_back(total);
+        total += static_cast<size_t>(std::max(1u, width >> level)) * std::max(1u, height >> level) * 4;
+    }
+
+    std::vector<uint8_t> chain(total);
+    const uint8_t* src = base;
+    for (uint32_t level = 1; level < mipLevels; level++)
+    {
+        uint8_t* dst = chain.data() + (*offsets)[level - 1];
+        DownsampleBox(src, std::max(1u, width >> (level - 1)), std::max(1u, height >> (level - 1)), dst);
+        src = dst;
+    }
+
+    return chain;
+}
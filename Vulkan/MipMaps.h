@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU mip generation for RGBA8, used when the device can't blit the texture format with linear filtering
+
+// Number of levels down to 1x1
+uint32_t MipLevelCount(uint32_t width, uint32_t height);
+
+// 2x2 box filter of one level into the next, odd edges repeat the last row/column
+// SSE2 for the bulk of every row, scalar for the rest
+void DownsampleBox(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst);
+
+// Levels 1..mipLevels-1 packed back to back (level 0 is not copied), offsets[i] is where level i+1 starts
+std::vector<uint8_t> GenerateMipChain(const uint8_t* base, uint32_t width, uint32_t height, uint32_t mipLevels, std::vector<size_t>* offsets);
@@ -0,0 +1,181 @@
+#include "PixelConvert.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXELCONVERT_SSE2
+#endif
+
+namespace
+{
+    // Exact round(value * alpha / 255) without a division, the SSE2 path does the same in 16 bit lanes
+    inline uint8_t MultiplyAlpha(uint32_t value, uint32_t alpha)
+    {
+        uint32_t product = value * alpha + 128;
+        return static_cast<uint8_t>((product + (product >> 8)) >> 8);
+    }
+
+    struct GammaTables
+    {
+        uint8_t toLinear[256];
+        uint8_t toSrgb[256];
+    };
+
+    const GammaTables& GetGammaTables()
+    {
+        static const GammaTables tables = []()
+        {
+            GammaTables result;
+            for (int it = 0; it < 256; it++)
+            {
+                double value = it / 255.0;
+                double linear = value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+                double srgb = value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+                result.toLinear[it] = static_cast<uint8_t>(linear * 255.0 + 0.5);
+                result.toSrgb[it] = static_cast<uint8_t>(srgb * 255.0 + 0.5);
+            }
+            return result;
+        }();
+        return tables;
+    }
+
+    // No gather before AVX2, a table lookup per byte is as fast as it gets
+    void ApplyTable(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride, const uint8_t* table)
+    {
+        for (uint32_t y = 0; y < height; y++)
+        {
+            uint8_t* row = pixels + y * stride;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                row[x * 4 + 0] = table[row[x * 4 + 0]];
+                row[x * 4 + 1] = table[row[x * 4 + 1]];
+                row[x * 4 + 2] = table[row[x * 4 + 2]];
+            }
+        }
+    }
+}
+
+void PremultiplyAlpha(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride)
+{
+#ifdef PIXELCONVERT_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    const __m128i alphaOne = _mm_and_si128(alphaLanes, _mm_set1_epi16(255));
+    const __m128i half = _mm_set1_epi16(128);
+
+    // Two pixels per 16 bit register, alpha is spread over its pixel's lanes and its own lane multiplies by 255
+    auto multiply = [&](__m128i color) -> __m128i
+    {
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(color, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        alpha = _mm_or_si128(_mm_andnot_si128(alphaLanes, alpha), alphaOne);
+        __m128i product = _mm_add_epi16(_mm_mullo_epi16(color, alpha), half);
+        return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+    };
+#endif
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        uint8_t* row = pixels + y * stride;
+        uint32_t x = 0;
+#ifdef PIXELCONVERT_SSE2
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i color = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4));
+            __m128i low = multiply(_mm_unpacklo_epi8(color, zero));
+            __m128i high = multiply(_mm_unpackhi_epi8(color, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x * 4), _mm_packus_epi16(low, high));
+        }
+#endif
+        for (; x < width; x++)
+        {
+            uint8_t* pixel = row + x * 4;
+            uint32_t alpha = pixel[3];
+            pixel[0] = MultiplyAlpha(pixel[0], alpha);
+            pixel[1] = MultiplyAlpha(pixel[1], alpha);
+            pixel[2] = MultiplyAlpha(pixel[2], alpha);
+        }
+    }
+}
+
+void SwapRedBlue(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride)
+{
+#ifdef PIXELCONVERT_SSE2
+    const __m128i greenAlpha = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+    const __m128i redBlue = _mm_set1_epi32(0x00FF00FF);
+#endif
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        uint8_t* row = pixels + y * stride;
+        uint32_t x = 0;
+#ifdef PIXELCONVERT_SSE2
+        // Bytes 0 and 2 of every pixel trade places through a 16 bit shift each way
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i color = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4));
+            __m128i swapped = _mm_and_si128(color, redBlue);
+            swapped = _mm_or_si128(_mm_slli_epi32(swapped, 16), _mm_srli_epi32(swapped, 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x * 4), _mm_or_si128(_mm_and_si128(color, greenAlpha), swapped));
+        }
+#endif
+        for (; x < width; x++)
+        {
+            uint8_t red = row[x * 4];
+            row[x * 4] = row[x * 4 + 2];
+            row[x * 4 + 2] = red;
+        }
+    }
+}
+
+void SrgbToLinear(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride)
+{
+    ApplyTable(pixels, width, height, stride, GetGammaTables().toLinear);
+}
+
+void LinearToSrgb(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride)
+{
+    ApplyTable(pixels, width, height, stride, GetGammaTables().toSrgb);
+}
+
+void ExtractChannel(const uint8_t* src, uint32_t width, uint32_t height, size_t srcStride, uint32_t channel, uint8_t* dst, size_t dstStride)
+{
+#ifdef PIXELCONVERT_SSE2
+    const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(channel * 8));
+    const __m128i lowByte = _mm_set1_epi32(0xFF);
+    auto load = [&](const uint8_t* pixel) -> __m128i
+    {
+        return _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel)), shift), lowByte);
+    };
+#endif
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* row = src + y * srcStride;
+        uint8_t* out = dst + y * dstStride;
+        uint32_t x = 0;
+#ifdef PIXELCONVERT_SSE2
+        // 16 pixels narrowed 32 -> 16 -> 8 bits, values never exceed 255 so the saturating packs don't clamp
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i first = _mm_packs_epi32(load(row + x * 4), load(row + x * 4 + 16));
+            __m128i second = _mm_packs_epi32(load(row + x * 4 + 32), load(row + x * 4 + 48));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(first, second));
+        }
+#endif
+        for (; x < width; x++)
+            out[x] = row[x * 4 + channel];
+    }
+}
+
+void ConvertPixels(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride, uint32_t conversions)
+{
+    if (conversions & PIXEL_SRGB_TO_LINEAR)
+        SrgbToLinear(pixels, width, height, stride);
+    if (conversions & PIXEL_PREMULTIPLY)
+        PremultiplyAlpha(pixels, width, height, stride);
+    if (conversions & PIXEL_SWAP_RED_BLUE)
+        SwapRedBlue(pixels, width, height, stride);
+    if (conversions & PIXEL_LINEAR_TO_SRGB)
+        LinearToSrgb(pixels, width, height, stride);
+}
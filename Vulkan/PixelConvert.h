@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// In place RGBA8 conversions that run between decode and upload (on the loader threads)
+// Rows are width * 4 bytes, stride apart, so they work on padded staging memory too
+// SSE2 for the bulk of every row, scalar for the rest, both give the same bytes
+
+// color * alpha / 255 rounded to nearest, alpha untouched
+void PremultiplyAlpha(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride);
+
+// RGBA <-> BGRA, for surfaces/formats that want the other byte order
+void SwapRedBlue(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride);
+
+// sRGB transfer function on RGB through a 256 entry table, alpha is always linear
+void SrgbToLinear(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride);
+void LinearToSrgb(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride);
+
+// One channel (0 = R, 1 = G, 2 = B, 3 = A) into an 8 bit image, e.g. alpha masks or R8 textures
+void ExtractChannel(const uint8_t* src, uint32_t width, uint32_t height, size_t srcStride, uint32_t channel, uint8_t* dst, size_t dstStride);
+
+enum PixelConversion : uint32_t
+{
+	PIXEL_SRGB_TO_LINEAR = 1 << 0,
+	PIXEL_PREMULTIPLY = 1 << 1,
+	PIXEL_SWAP_RED_BLUE = 1 << 2,
+	PIXEL_LINEAR_TO_SRGB = 1 << 3,
+};
+
+// Everything set in conversions (PixelConversion bits), in the order of the enum
+// so premultiplying happens on linear values when both are asked for
+void ConvertPixels(uint8_t* pixels, uint32_t width, uint32_t height, size_t stride, uint32_t conversions);
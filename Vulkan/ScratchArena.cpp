@@ -0,0 +1,57 @@
+#include "ScratchArena.h"
+
+#include <algorithm>
+
+static const size_t SCRATCH_ALIGNMENT = 16;
+static const size_t SCRATCH_MIN_BLOCK = 1024 * 1024;
+
+ScratchArena& ScratchArena::ForThread()
+{
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+uint8_t* ScratchArena::Allocate(size_t size)
+{
+    size_t offset = (m_used + SCRATCH_ALIGNMENT - 1) & ~(SCRATCH_ALIGNMENT - 1);
+    if (!m_blocks.empty() && offset + size <= m_blocks[m_block].size)
+    {
+        m_used = offset + size;
+        return m_blocks[m_block].data.get() + offset;
+    }
+
+    // Blocks after the current one are free, reuse the next if it fits, otherwise replace them with a bigger one
+    size_t next = m_blocks.empty() ? 0 : m_block + 1;
+    if (next >= m_blocks.size() || m_blocks[next].size < size)
+    {
+        m_blocks.resize(next);
+        size_t blockSize = std::max({ size, SCRATCH_MIN_BLOCK, m_blocks.empty() ? 0 : 2 * m_blocks.back().size });
+        m_blocks.push_back({ std::unique_ptr<uint8_t[]>(new uint8_t[blockSize]), blockSize });
+    }
+
+    m_block = next;
+    m_used = size;
+    return m_blocks[m_block].data.get();
+}
+
+void ScratchArena::Rewind(size_t block, size_t used)
+{
+    m_block = block;
+    m_used = used;
+
+    // Back to empty after needing several blocks: merge them so the same work fits in one next time
+    if (block == 0 && used == 0 && m_blocks.size() > 1)
+    {
+        size_t total = GetCapacity();
+        m_blocks.clear();
+        m_blocks.push_back({ std::unique_ptr<uint8_t[]>(new uint8_t[total]), total });
+    }
+}
+
+size_t ScratchArena::GetCapacity() const
+{
+    size_t total = 0;
+    for (const auto& block : m_blocks)
+        total += block.size;
+    return total;
+}
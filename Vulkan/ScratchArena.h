@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Per thread bump allocator for decoder scratch (joined IDAT chunks, inflated rows...)
+// A Scope hands back everything allocated inside it, blocks stay with the thread, so a decode loop settles
+// on one block per thread instead of a malloc/free pair per image
+class ScratchArena
+{
+public:
+	ScratchArena() = default;
+
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	// Arena of the calling thread, created on first use
+	static ScratchArena& ForThread();
+
+	// Uninitialized, 16 byte aligned, valid until the enclosing Scope ends
+	uint8_t* Allocate(size_t size);
+
+	class Scope
+	{
+	public:
+		explicit Scope(ScratchArena& arena) : m_arena(arena), m_block(arena.m_block), m_used(arena.m_used) {}
+		~Scope() { m_arena.Rewind(m_block, m_used); }
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		ScratchArena& m_arena;
+		size_t m_block;
+		size_t m_used;
+	};
+
+	size_t GetCapacity() const;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<uint8_t[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> m_blocks;
+	size_t m_block = 0; // block Allocate takes from
+	size_t m_used = 0;  // bytes of it in use
+
+	void Rewind(size_t block, size_t used);
+};
@@ -0,0 +1,152 @@
+#include "SecondaryRecorder.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+SecondaryRecorder::SecondaryRecorder(VkDevice device, uint32_t queueFamily, uint32_t setCount, size_t threadCount)
+    : m_device(device), m_sets(setCount)
+{
+    // Pools are reset as a whole instead of buffer by buffer
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamily;
+
+    for (Set& set : m_sets)
+    {
+        set.slots.resize(threadCount + 1);
+        for (Slot& slot : set.slots)
+        {
+            if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &slot.pool) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create secondary command pool");
+        }
+    }
+
+    for (size_t thread = 0; thread < threadCount; thread++)
+        m_workers.emplace_back(&SecondaryRecorder::Worker, this);
+}
+
+SecondaryRecorder::~SecondaryRecorder()
+{
+    m_jobs.Close();
+    for (auto& worker : m_workers)
+        worker.join();
+
+    // Destroying a pool frees its buffers
+    for (Set& set : m_sets)
+    {
+        for (Slot& slot : set.slots)
+            vkDestroyCommandPool(m_device, slot.pool, nullptr);
+    }
+}
+
+void SecondaryRecorder::Begin(uint32_t set, VkRenderPass renderPass, VkFramebuffer framebuffer)
+{
+    m_set = set;
+    m_sets[set].recorded.clear();
+
+    for (Slot& slot : m_sets[set].slots)
+    {
+        vkResetCommandPool(m_device, slot.pool, 0);
+        slot.used = 0;
+    }
+
+    m_inheritance = {};
+    m_inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    m_inheritance.renderPass = renderPass;
+    m_inheritance.subpass = 0;
+    m_inheritance.framebuffer = framebuffer;
+}
+
+void SecondaryRecorder::RecordParallel(size_t count, const RecordRange& record)
+{
+    if (count == 0)
+        return;
+
+    if (m_workers.empty())
+    {
+        Record([&](VkCommandBuffer commandBuffer) { record(commandBuffer, 0, count); });
+        return;
+    }
+
+    // One range per worker, a worker slot is only ever used by the job holding it
+    size_t rangeSize = (count + m_workers.size() - 1) / m_workers.size();
+    size_t jobCount = 0;
+    for (size_t first = 0; first < count; first += rangeSize)
+        m_jobs.Push({ jobCount++, first, std::min(first + rangeSize, count), &record });
+
+    // Every job reports back, even failed ones, so record isn't used after returning
+    std::vector<VkCommandBuffer> recorded(jobCount, VK_NULL_HANDLE);
+    std::exception_ptr error;
+    for (size_t job = 0; job < jobCount; job++)
+    {
+        Done done;
+        m_done.Pop(done);
+        recorded[done.slot] = done.commandBuffer;
+        if (done.error && !error)
+            error = done.error;
+    }
+    if (error)
+        std::rethrow_exception(error);
+
+    m_sets[m_set].recorded.insert(m_sets[m_set].recorded.end(), recorded.begin(), recorded.end());
+}
+
+void SecondaryRecorder::Record(const std::function<void(VkCommandBuffer commandBuffer)>& record)
+{
+    VkCommandBuffer commandBuffer = BeginBuffer(m_sets[m_set].slots.size() - 1);
+    record(commandBuffer);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to stop recording a secondary command buffer");
+    m_sets[m_set].recorded.push_back(commandBuffer);
+}
+
+VkCommandBuffer SecondaryRecorder::BeginBuffer(size_t slotIndex)
+{
+    Slot& slot = m_sets[m_set].slots[slotIndex];
+    if (slot.used == slot.buffers.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = slot.pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate secondary command buffer");
+        slot.buffers.push_back(commandBuffer);
+    }
+
+    VkCommandBuffer commandBuffer = slot.buffers[slot.used++];
+
+    // Everything it records happens inside the primary's render pass, not one time submit, a set may be executed many times
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &m_inheritance;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to start recording a secondary command buffer");
+    return commandBuffer;
+}
+
+void SecondaryRecorder::Worker()
+{
+    Job job;
+    while (m_jobs.Pop(job))
+    {
+        Done done = { job.slot, VK_NULL_HANDLE, nullptr };
+        try
+        {
+            done.commandBuffer = BeginBuffer(job.slot);
+            (*job.record)(done.commandBuffer, job.first, job.last);
+            if (vkEndCommandBuffer(done.commandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("Failed to stop recording a secondary command buffer");
+        }
+        catch (...)
+        {
+            done.error = std::current_exception();
+        }
+        m_done.Push(done);
+    }
+}
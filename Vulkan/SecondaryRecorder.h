@@ -0,0 +1,80 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "WorkQueue.h"
+
+// Records the inside of a render pass into secondary command buffers, in parallel where the caller allows it
+// Pools come in sets (one per frame in flight, one per swapchain image...), every worker slot has its own pool in each
+// set, so recording needs no locks. Begin resets a set as a whole, until then its buffers can be executed again and again
+// The primary executes GetCommandBuffers(set) in order, which is the order Record/RecordParallel were called in
+class SecondaryRecorder
+{
+public:
+	// commandBuffer is begun and ended by the recorder, the range is [first, last)
+	using RecordRange = std::function<void(VkCommandBuffer commandBuffer, size_t first, size_t last)>;
+
+	SecondaryRecorder(VkDevice device, uint32_t queueFamily, uint32_t setCount, size_t threadCount);
+	~SecondaryRecorder();
+
+	SecondaryRecorder(const SecondaryRecorder&) = delete;
+	SecondaryRecorder& operator=(const SecondaryRecorder&) = delete;
+
+	// Resets set and records into it from here on, continuing renderPass on framebuffer (subpass 0)
+	// Nothing executing the set's buffers may still be pending
+	void Begin(uint32_t set, VkRenderPass renderPass, VkFramebuffer framebuffer);
+	// Splits [0, count) into one contiguous range per worker and waits for all of them, record runs on the workers
+	void RecordParallel(size_t count, const RecordRange& record);
+	// Records into a secondary of its own on the calling thread
+	void Record(const std::function<void(VkCommandBuffer commandBuffer)>& record);
+
+	const std::vector<VkCommandBuffer>& GetCommandBuffers(uint32_t set) const { return m_sets[set].recorded; }
+	size_t GetThreadCount() const { return m_workers.size(); }
+
+private:
+	struct Slot
+	{
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> buffers; // allocated as needed, reused every time the set is begun
+		size_t used = 0;
+	};
+
+	struct Job
+	{
+		size_t slot;
+		size_t first;
+		size_t last;
+		const RecordRange* record;
+	};
+
+	struct Done
+	{
+		size_t slot;
+		VkCommandBuffer commandBuffer;
+		std::exception_ptr error;
+	};
+
+	struct Set
+	{
+		std::vector<Slot> slots; // the last slot belongs to the calling thread
+		std::vector<VkCommandBuffer> recorded;
+	};
+
+	VkDevice m_device;
+	std::vector<Set> m_sets;
+	uint32_t m_set = 0; // set being recorded
+	VkCommandBufferInheritanceInfo m_inheritance = {};
+
+	WorkQueue<Job> m_jobs;
+	WorkQueue<Done> m_done;
+	std::vector<std::thread> m_workers;
+
+	VkCommandBuffer BeginBuffer(size_t slot);
+	void Worker();
+};
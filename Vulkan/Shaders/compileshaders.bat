@@ -1,3 +1,7 @@
 C:/VulkanSDK/1.3.204.1/Bin/glslangValidator.exe -V shader.vert
 C:/VulkanSDK/1.3.204.1/Bin/glslangValidator.exe -V shader.frag
+C:/VulkanSDK/1.3.204.1/Bin/glslangValidator.exe -V shader_instanced.vert -o vert_instanced.spv
+C:/VulkanSDK/1.3.204.1/Bin/glslangValidator.exe -V shader_instanced.frag -o frag_instanced.spv
+C:/VulkanSDK/1.3.204.1/Bin/glslangValidator.exe -V -DBINDLESS shader.frag -o frag_bindless.spv
+C:/VulkanSDK/1.3.204.1/Bin/glslangValidator.exe -V -DBINDLESS shader_instanced.frag -o frag_instanced_bindless.spv
 pause
\ No newline at end of file
@@ -1,17 +1,33 @@
 #version 450
+// Built twice, with -DBINDLESS every texture comes from one array indexed per draw
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
 layout(location = 0) out vec4 outColor; // final output color must have loca
 layout(location = 0) in vec3 fragColor;
-layout(set = 1, binding = 0) uniform sampler2D textureSampler;
+// Every texture is an array, single textures simply have one layer
+#ifdef BINDLESS
+layout(set = 1, binding = 0) uniform sampler2DArray textureSamplers[];
+#else
+layout(set = 1, binding = 0) uniform sampler2DArray textureSampler;
+#endif
 
 layout(location = 1) in vec2 fragTex;
 layout(location = 2) in float hasTex;
+layout(location = 3) flat in int texLayer;
+layout(location = 4) flat in int texIndex;
 
 void main()
 {
    if (hasTex > 0.5)
    {
-    outColor = texture(textureSampler, fragTex);
+    // Texels are premultiplied on load, blending takes them as they are (no alpha math here)
+#ifdef BINDLESS
+    outColor = texture(textureSamplers[nonuniformEXT(texIndex)], vec3(fragTex, texLayer));
+#else
+    outColor = texture(textureSampler, vec3(fragTex, texLayer));
+#endif
    }
    else 
    {
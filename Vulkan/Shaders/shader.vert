@@ -4,6 +4,7 @@ layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 col;
 layout(location = 2) in vec2 tex;
 layout(location = 3) in float bTex;
+layout(location = 4) in float layer; // per vertex layer of batched sprites, 0 for meshes drawn one by one
 
 layout(set = 0, binding = 0) uniform ViewProjection
 {
@@ -20,15 +21,21 @@ layout(set = 0, binding = 1) uniform Model
 layout(push_constant) uniform PushModel
 {
   mat4 model;
+  int textureLayer;
+  int textureIndex; // bindless array element, unused otherwise
 } pushModel;
 
 layout(location = 0) out vec3 fragCol;
 layout(location = 1) out vec2 fragTex;
 layout(location = 2) out float hasTex;
+layout(location = 3) flat out int texLayer;
+layout(location = 4) flat out int texIndex;
 void main()
 {
     gl_Position = viewprojection.projection * viewprojection.view * pushModel.model * vec4(pos, 1.0);
 	fragCol = col;
 	fragTex = tex;
 	hasTex = bTex;
+	texLayer = pushModel.textureLayer + int(layer);
+	texIndex = pushModel.textureIndex;
 }
\ No newline at end of file
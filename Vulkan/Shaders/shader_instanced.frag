@@ -0,0 +1,36 @@
+#version 450
+// Built twice, with -DBINDLESS every texture comes from one array indexed per instance
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
+layout(location = 0) out vec4 outColor;
+layout(location = 0) in vec4 fragTint;
+// Every texture is an array, single textures simply have one layer
+#ifdef BINDLESS
+layout(set = 1, binding = 0) uniform sampler2DArray textureSamplers[];
+#else
+layout(set = 1, binding = 0) uniform sampler2DArray textureSampler;
+#endif
+
+layout(location = 1) in vec2 fragTex;
+layout(location = 2) in float hasTex;
+layout(location = 3) flat in int texLayer;
+layout(location = 4) flat in int texIndex;
+
+void main()
+{
+   if (hasTex > 0.5)
+   {
+    // Texels are premultiplied on load, a premultiplied tint keeps them that way
+#ifdef BINDLESS
+    outColor = texture(textureSamplers[nonuniformEXT(texIndex)], vec3(fragTex, texLayer)) * fragTint;
+#else
+    outColor = texture(textureSampler, vec3(fragTex, texLayer)) * fragTint;
+#endif
+   }
+   else 
+   {
+     outColor = fragTint;
+   }
+}
@@ -0,0 +1,34 @@
+#version 450 // use GLSL 4.5
+
+// Shared unit quad (binding 0, per vertex)
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec2 tex;
+
+// SpriteInstance (binding 1, per instance), a mat4 takes locations 2 to 5
+layout(location = 2) in mat4 transform;
+layout(location = 6) in vec4 uvRect;
+layout(location = 7) in vec4 tint;
+layout(location = 8) in float layer;
+layout(location = 9) in float bTex;
+layout(location = 10) in int textureIndex; // bindless array element, unused otherwise
+
+layout(set = 0, binding = 0) uniform ViewProjection
+{
+   mat4 projection;
+   mat4 view;
+} viewprojection;
+
+layout(location = 0) out vec4 fragTint;
+layout(location = 1) out vec2 fragTex;
+layout(location = 2) out float hasTex;
+layout(location = 3) flat out int texLayer;
+layout(location = 4) flat out int texIndex;
+void main()
+{
+    gl_Position = viewprojection.projection * viewprojection.view * transform * vec4(pos, 1.0);
+	fragTint = tint;
+	fragTex = uvRect.xy + tex * uvRect.zw;
+	hasTex = bTex;
+	texLayer = int(layer);
+	texIndex = textureIndex;
+}
@@ -0,0 +1,82 @@
+#include "SpriteBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Streams start big enough for this many quads
+static const VkDeviceSize SPRITE_STREAM_INITIAL_QUADS = 4096;
+
+SpriteBatcher::SpriteBatcher(DeviceAllocator& allocator, uint32_t streamCount)
+    : m_allocator(allocator), m_streams(streamCount)
+{
+}
+
+SpriteBatcher::~SpriteBatcher()
+{
+    for (auto& stream : m_streams)
+    {
+        if (stream.vertexBuffer != VK_NULL_HANDLE)
+            m_allocator.DestroyBuffer(stream.vertexBuffer, stream.vertexMemory);
+        if (stream.indexBuffer != VK_NULL_HANDLE)
+            m_allocator.DestroyBuffer(stream.indexBuffer, stream.indexMemory);
+    }
+}
+
+void SpriteBatcher::Begin()
+{
+    m_vertices.clear();
+    m_indices.clear();
+    m_batches.clear();
+    m_spriteCount = 0;
+}
+
+void SpriteBatcher::Add(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const glm::mat4& model, int textureLayer, int texId)
+{
+    uint32_t baseVertex = static_cast<uint32_t>(m_vertices.size());
+    for (const Vertex& vertex : vertices)
+    {
+        Vertex moved = vertex;
+        moved.m_position = glm::vec3(model * glm::vec4(vertex.m_position, 1.0f));
+        moved.m_textureLayer = static_cast<float>(textureLayer);
+        m_vertices.push_back(moved);
+    }
+
+    // A batch only breaks when the texture changes, the layer travels with the vertices
+    if (m_batches.empty() || m_batches.back().texId != texId)
+        m_batches.push_back({ texId, static_cast<uint32_t>(m_indices.size()), 0 });
+
+    for (uint32_t index : indices)
+        m_indices.push_back(baseVertex + index);
+    m_batches.back().indexCount += static_cast<uint32_t>(indices.size());
+    m_spriteCount++;
+}
+
+void SpriteBatcher::End(uint32_t image)
+{
+    if (m_indices.empty())
+        return;
+
+    Stream& stream = m_streams[image];
+    VkDeviceSize vertexBytes = m_vertices.size() * sizeof(Vertex);
+    VkDeviceSize indexBytes = m_indices.size() * sizeof(uint32_t);
+    Reserve(&stream.vertexBuffer, &stream.vertexMemory, &stream.vertexCapacity, vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    Reserve(&stream.indexBuffer, &stream.indexMemory, &stream.indexCapacity, indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+    // Coherent memory, visible to the draws submitted after this
+    memcpy(stream.vertexMemory.mapped, m_vertices.data(), static_cast<size_t>(vertexBytes));
+    memcpy(stream.indexMemory.mapped, m_indices.data(), static_cast<size_t>(indexBytes));
+}
+
+void SpriteBatcher::Reserve(VkBuffer* buffer, DeviceAllocation* memory, VkDeviceSize* capacity, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    if (size <= *capacity)
+        return;
+
+    // Nothing uses the old buffer any more, its image has finished
+    if (*buffer != VK_NULL_HANDLE)
+        m_allocator.DestroyBuffer(*buffer, *memory);
+
+    VkDeviceSize initial = SPRITE_STREAM_INITIAL_QUADS * ((usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) ? 4 * sizeof(Vertex) : 6 * sizeof(uint32_t));
+    *capacity = std::max(std::max(initial, *capacity * 2), size);
+    *memory = m_allocator.CreateBuffer(*capacity, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer);
+}
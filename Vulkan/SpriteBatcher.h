@@ -0,0 +1,62 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+#include "DeviceAllocator.h"
+#include "Utilites.h"
+
+// Sprites moved to world space on the CPU and appended to one vertex/index stream, drawn with one vkCmdDrawIndexed
+// per run of sprites sharing a texture instead of one bind/push/draw per mesh
+// Every swapchain image has its own streams in host visible memory (a retained scene keeps drawing from them), they grow as needed and are never shrunk
+class SpriteBatcher
+{
+public:
+	struct Batch
+	{
+		int texId;          // -1 = untextured
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	SpriteBatcher(DeviceAllocator& allocator, uint32_t streamCount);
+	~SpriteBatcher();
+
+	SpriteBatcher(const SpriteBatcher&) = delete;
+	SpriteBatcher& operator=(const SpriteBatcher&) = delete;
+
+	void Begin();
+	// Indices are relative to the sprite's first vertex, textureLayer goes into every vertex
+	void Add(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const glm::mat4& model, int textureLayer, int texId);
+	// Writes the streams of image, whatever last drew from them must have finished (its fence waited on)
+	void End(uint32_t image);
+
+	VkBuffer GetVertexBuffer(uint32_t image) const { return m_streams[image].vertexBuffer; }
+	VkBuffer GetIndexBuffer(uint32_t image) const { return m_streams[image].indexBuffer; }
+	const std::vector<Batch>& GetBatches() const { return m_batches; }
+	size_t GetSpriteCount() const { return m_spriteCount; }
+
+private:
+	struct Stream
+	{
+		VkBuffer vertexBuffer = VK_NULL_HANDLE;
+		DeviceAllocation vertexMemory;
+		VkDeviceSize vertexCapacity = 0;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		DeviceAllocation indexMemory;
+		VkDeviceSize indexCapacity = 0;
+	};
+
+	DeviceAllocator& m_allocator;
+	std::vector<Stream> m_streams;
+
+	// Filled on the CPU first, kept between frames so steady state doesn't allocate
+	std::vector<Vertex> m_vertices;
+	std::vector<uint32_t> m_indices;
+	std::vector<Batch> m_batches;
+	size_t m_spriteCount = 0;
+
+	void Reserve(VkBuffer* buffer, DeviceAllocation* memory, VkDeviceSize* capacity, VkDeviceSize size, VkBufferUsageFlags usage);
+};
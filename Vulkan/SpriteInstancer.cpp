@@ -0,0 +1,138 @@
+#include "SpriteInstancer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Instance streams start big enough for this many sprites
+static const VkDeviceSize SPRITE_INSTANCES_INITIAL = 4096;
+
+// Indirect command buffers start big enough for this many runs
+static const VkDeviceSize SPRITE_COMMANDS_INITIAL = 64;
+
+SpriteInstancer::SpriteInstancer(DeviceAllocator& allocator, UploadBatch& uploadBatch, uint32_t streamCount, bool indexedTextures, bool indirect)
+    : m_allocator(allocator), m_uploadBatch(uploadBatch), m_streams(streamCount), m_indexedTextures(indexedTextures), m_indirect(indirect)
+{
+    // Unit quad going right and down from the origin, sprites place and size it with their transform
+    std::vector<Vertex> quad =
+    {
+        { { 0.0f, 0.0f, 0.0f },  { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f }, 1.0f },
+        { { 0.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f }, 1.0f },
+        { { 1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f }, 1.0f },
+        { { 1.0f, 0.0f, 0.0f },  { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f }, 1.0f },
+    };
+
+    VkDeviceSize vertexBytes = quad.size() * sizeof(Vertex);
+    VkDeviceSize indexBytes = MESH_INDICES.size() * sizeof(uint32_t);
+    m_quadVertexMemory = m_allocator.CreateBuffer(vertexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_quadVertexBuffer);
+    m_quadIndexMemory = m_allocator.CreateBuffer(indexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_quadIndexBuffer);
+
+    uploadBatch.Begin();
+    uploadBatch.EnqueueBufferCopy(quad.data(), vertexBytes, m_quadVertexBuffer);
+    uploadBatch.EnqueueBufferCopy(MESH_INDICES.data(), indexBytes, m_quadIndexBuffer);
+    uploadBatch.End();
+}
+
+SpriteInstancer::~SpriteInstancer()
+{
+    for (auto& stream : m_streams)
+    {
+        if (stream.buffer != VK_NULL_HANDLE)
+            m_allocator.DestroyBuffer(stream.buffer, stream.memory);
+        if (stream.commandBuffer != VK_NULL_HANDLE)
+            m_allocator.DestroyBuffer(stream.commandBuffer, stream.commandMemory);
+        if (stream.countBuffer != VK_NULL_HANDLE)
+            m_allocator.DestroyBuffer(stream.countBuffer, stream.countMemory);
+    }
+    m_allocator.DestroyBuffer(m_quadVertexBuffer, m_quadVertexMemory);
+    m_allocator.DestroyBuffer(m_quadIndexBuffer, m_quadIndexMemory);
+}
+
+void SpriteInstancer::Begin()
+{
+    m_instances.clear();
+    m_batches.clear();
+}
+
+void SpriteInstancer::Add(const std::vector<Vertex>& vertices, const glm::mat4& model, int textureLayer, int texId)
+{
+    if (vertices.size() != 4)
+        throw std::runtime_error("Only quads can be drawn instanced");
+
+    const Vertex& topLeft = vertices[0];
+    const Vertex& bottomRight = vertices[2];
+
+    // Unit quad -> the mesh's own rectangle -> the mesh's model
+    glm::vec3 size = { bottomRight.m_position.x - topLeft.m_position.x, topLeft.m_position.y - bottomRight.m_position.y, 1.0f };
+    glm::mat4 local = glm::scale(glm::translate(glm::mat4(1.0f), topLeft.m_position), size);
+
+    SpriteInstance instance;
+    instance.m_transform = model * local;
+    instance.m_uvRect = glm::vec4(topLeft.m_tex, bottomRight.m_tex - topLeft.m_tex);
+    // Textured meshes have no color of their own, the texel goes through untouched
+    instance.m_tint = topLeft.hasTexture > 0.5f ? glm::vec4(1.0f) : glm::vec4(topLeft.m_color, 1.0f);
+    instance.m_textureLayer = static_cast<float>(textureLayer) + topLeft.m_textureLayer;
+    instance.m_hasTexture = topLeft.hasTexture;
+    instance.m_textureIndex = std::max(texId, 0); // untextured sprites never sample it
+
+    // Same as the sprite batcher, only a texture change breaks the run, and not even that with indexed textures
+    if (m_batches.empty() || (!m_indexedTextures && m_batches.back().texId != texId))
+        m_batches.push_back({ texId, static_cast<uint32_t>(m_instances.size()), 0 });
+
+    m_instances.push_back(instance);
+    m_batches.back().instanceCount++;
+}
+
+void SpriteInstancer::End(uint32_t image)
+{
+    if (m_instances.empty())
+        return;
+
+    Stream& stream = m_streams[image];
+    VkDeviceSize size = m_instances.size() * sizeof(SpriteInstance);
+    if (!m_indirect)
+    {
+        Reserve(stream.buffer, stream.memory, stream.capacity, size, SPRITE_INSTANCES_INITIAL * sizeof(SpriteInstance), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+
+        // Coherent memory, visible to the draws submitted after this
+        memcpy(stream.memory.mapped, m_instances.data(), static_cast<size_t>(size));
+        return;
+    }
+
+    // Instances are read as vertex attributes for now, storage usage is for whatever compute pass rewrites them later
+    Reserve(stream.buffer, stream.memory, stream.capacity, size, SPRITE_INSTANCES_INITIAL * sizeof(SpriteInstance),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    m_commands.clear();
+    for (const auto& batch : m_batches)
+        m_commands.push_back({ GetQuadIndexCount(), batch.instanceCount, 0, 0, batch.firstInstance });
+
+    VkDeviceSize commandBytes = m_commands.size() * sizeof(VkDrawIndexedIndirectCommand);
+    VkBufferUsageFlags indirectUsage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    Reserve(stream.commandBuffer, stream.commandMemory, stream.commandCapacity, commandBytes, SPRITE_COMMANDS_INITIAL * sizeof(VkDrawIndexedIndirectCommand), indirectUsage);
+    if (stream.countBuffer == VK_NULL_HANDLE)
+        stream.countMemory = m_allocator.CreateBuffer(sizeof(uint32_t), indirectUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &stream.countBuffer);
+
+    uint32_t commandCount = static_cast<uint32_t>(m_commands.size());
+    m_uploadBatch.Begin();
+    m_uploadBatch.EnqueueBufferCopy(m_instances.data(), size, stream.buffer);
+    m_uploadBatch.EnqueueBufferCopy(m_commands.data(), commandBytes, stream.commandBuffer);
+    m_uploadBatch.EnqueueBufferCopy(&commandCount, sizeof(commandCount), stream.countBuffer);
+    m_uploadBatch.End();
+}
+
+void SpriteInstancer::Reserve(VkBuffer& buffer, DeviceAllocation& memory, VkDeviceSize& capacity, VkDeviceSize size, VkDeviceSize initial, VkBufferUsageFlags usage)
+{
+    if (size <= capacity)
+        return;
+
+    // Nothing uses the old buffer any more, its image has finished
+    if (buffer != VK_NULL_HANDLE)
+        m_allocator.DestroyBuffer(buffer, memory);
+
+    // Host visible when the CPU writes it directly, device local when it's uploaded
+    VkMemoryPropertyFlags properties = m_indirect ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    capacity = std::max(std::max(initial, capacity * 2), size);
+    memory = m_allocator.CreateBuffer(capacity, usage, properties, &buffer);
+}
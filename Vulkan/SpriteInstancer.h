@@ -0,0 +1,95 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+#include "DeviceAllocator.h"
+#include "UploadBatch.h"
+#include "Utilites.h"
+
+// Per instance attributes of the instanced pipeline (binding 1), layout must match shader_instanced.vert
+struct SpriteInstance
+{
+	glm::mat4 m_transform;  // unit quad -> world
+	glm::vec4 m_uvRect;     // u, v, width, height of the texture area
+	glm::vec4 m_tint;       // multiplies the texel, the color of untextured sprites
+	float m_textureLayer;
+	float m_hasTexture;
+	int32_t m_textureIndex; // element of the bindless texture array
+};
+
+// Every sprite is the same quad, so it lives once on the GPU and sprites only differ by a SpriteInstance
+// A run of sprites sharing a texture is one vkCmdDrawIndexed with instanceCount, no matter how many sprites it holds
+// With indexed (bindless) textures each instance names its own texture and there is only one run
+// Every swapchain image has its own instance stream in host visible memory, grown as needed and never shrunk
+// Indirect mode keeps the instances in device local storage buffers instead, next to a VkDrawIndexedIndirectCommand per run
+// and the run count, all uploaded when the scene is recorded. The recorded draws only point at the buffers, so a compute
+// pass can later cull/compact instances and rewrite commands and count without the recording code knowing
+class SpriteInstancer
+{
+public:
+	struct Batch
+	{
+		int texId;          // -1 = untextured, first sprite's texture with indexed textures
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	SpriteInstancer(DeviceAllocator& allocator, UploadBatch& uploadBatch, uint32_t streamCount, bool indexedTextures, bool indirect);
+	~SpriteInstancer();
+
+	SpriteInstancer(const SpriteInstancer&) = delete;
+	SpriteInstancer& operator=(const SpriteInstancer&) = delete;
+
+	void Begin();
+	// vertices is a quad in the MESH_INDICES order (top left, bottom left, bottom right, top right)
+	void Add(const std::vector<Vertex>& vertices, const glm::mat4& model, int textureLayer, int texId);
+	// Writes the instance stream of image (and its commands in indirect mode), whatever last drew from it must have finished
+	// (its fence waited on). Indirect uploads go through the upload batch, submitted before the draws reading them
+	void End(uint32_t image);
+
+	VkBuffer GetQuadVertexBuffer() const { return m_quadVertexBuffer; }
+	VkBuffer GetQuadIndexBuffer() const { return m_quadIndexBuffer; }
+	uint32_t GetQuadIndexCount() const { return static_cast<uint32_t>(MESH_INDICES.size()); }
+	VkBuffer GetInstanceBuffer(uint32_t image) const { return m_streams[image].buffer; }
+	// Indirect mode only, one command per batch in GetBatches order, the count buffer holds a single uint32_t
+	VkBuffer GetCommandBuffer(uint32_t image) const { return m_streams[image].commandBuffer; }
+	VkBuffer GetCountBuffer(uint32_t image) const { return m_streams[image].countBuffer; }
+	bool IsIndirect() const { return m_indirect; }
+	const std::vector<Batch>& GetBatches() const { return m_batches; }
+	size_t GetSpriteCount() const { return m_instances.size(); }
+
+private:
+	struct Stream
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		DeviceAllocation memory;
+		VkDeviceSize capacity = 0;
+		VkBuffer commandBuffer = VK_NULL_HANDLE;
+		DeviceAllocation commandMemory;
+		VkDeviceSize commandCapacity = 0;
+		VkBuffer countBuffer = VK_NULL_HANDLE;
+		DeviceAllocation countMemory;
+	};
+
+	DeviceAllocator& m_allocator;
+	UploadBatch& m_uploadBatch;
+	std::vector<Stream> m_streams;
+	bool m_indexedTextures;
+	bool m_indirect;
+
+	VkBuffer m_quadVertexBuffer = VK_NULL_HANDLE;
+	DeviceAllocation m_quadVertexMemory;
+	VkBuffer m_quadIndexBuffer = VK_NULL_HANDLE;
+	DeviceAllocation m_quadIndexMemory;
+
+	// Filled on the CPU first, kept between frames so steady state doesn't allocate
+	std::vector<SpriteInstance> m_instances;
+	std::vector<Batch> m_batches;
+	std::vector<VkDrawIndexedIndirectCommand> m_commands;
+
+	// Grows buffer to hold size bytes, its old contents are dropped
+	void Reserve(VkBuffer& buffer, DeviceAllocation& memory, VkDeviceSize& capacity, VkDeviceSize size, VkDeviceSize initial, VkBufferUsageFlags usage);
+};
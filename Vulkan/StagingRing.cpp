@@ -0,0 +1,81 @@
+#include "StagingRing.h"
+
+#include <stdexcept>
+#include "Utilites.h"
+
+StagingRing::StagingRing(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize capacity)
+    : m_device(device), m_capacity(capacity)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &m_buffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create staging ring");
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, m_buffer, &memoryRequirements);
+
+    // Write combined memory is fine for memcpy but reading it back is uncached, take a cached type if there is one
+    const VkMemoryPropertyFlags required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t memoryType;
+    try
+    {
+        memoryType = FindMemoryTypeIndex(memoryRequirements.memoryTypeBits, required | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, physicalDevice);
+    }
+    catch (const std::runtime_error&)
+    {
+        memoryType = FindMemoryTypeIndex(memoryRequirements.memoryTypeBits, required, physicalDevice);
+    }
+
+    VkMemoryAllocateInfo memoryAllocateInfo = {};
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.allocationSize = memoryRequirements.size;
+    memoryAllocateInfo.memoryTypeIndex = memoryType;
+    if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &m_memory) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate staging ring");
+    vkBindBufferMemory(device, m_buffer, m_memory, 0);
+
+    // Mapped once for the whole lifetime
+    void* mapped;
+    if (vkMapMemory(device, m_memory, 0, capacity, 0, &mapped) != VK_SUCCESS)
+        throw std::runtime_error("Failed to map staging ring");
+    m_mapped = static_cast<uint8_t*>(mapped);
+}
+
+StagingRing::~StagingRing()
+{
+    vkUnmapMemory(m_device, m_memory);
+    vkDestroyBuffer(m_device, m_buffer, nullptr);
+    vkFreeMemory(m_device, m_memory, nullptr);
+}
+
+bool StagingRing::TryAllocate(VkDeviceSize size, VkDeviceSize alignment, Allocation* allocation)
+{
+    if (size > m_capacity)
+        return false;
+
+    uint64_t start = (m_head + alignment - 1) & ~(alignment - 1);
+
+    // Allocation can't be split, skip the rest of the buffer and start again from offset 0
+    if (start % m_capacity + size > m_capacity)
+        start += m_capacity - start % m_capacity;
+
+    if (start + size - m_tail > m_capacity)
+        return false;
+
+    m_head = start + size;
+
+    allocation->buffer = m_buffer;
+    allocation->offset = start % m_capacity;
+    allocation->mapped = m_mapped + allocation->offset;
+    allocation->position = start;
+    return true;
+}
+
+void StagingRing::Release(uint64_t position)
+{
+    if (position > m_tail)
+        m_tail = position;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+
+// One persistently mapped host visible buffer that uploads suballocate from in a circle
+// Positions only grow (offset in buffer = position % capacity), so "how far did the GPU get" is a single number
+// Owner releases space up to a position once the submit that read it has finished
+// Memory is host cached when the device has such a type, decode threads read back what they wrote (hashing)
+class StagingRing
+{
+public:
+	StagingRing(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize capacity);
+	~StagingRing();
+
+	StagingRing(const StagingRing&) = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+
+	struct Allocation
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		uint8_t* mapped;
+		uint64_t position; // where the allocation starts, Release up to here keeps it
+	};
+
+	// False when the space is still in use by the GPU, caller has to wait and Release first
+	bool TryAllocate(VkDeviceSize size, VkDeviceSize alignment, Allocation* allocation);
+	void Release(uint64_t position);
+
+	uint64_t GetHead() const { return m_head; }
+	VkDeviceSize GetCapacity() const { return m_capacity; }
+	VkDeviceSize GetUsed() const { return m_head - m_tail; }
+
+private:
+	VkDevice m_device;
+	VkBuffer m_buffer;
+	VkDeviceMemory m_memory;
+	uint8_t* m_mapped;
+	VkDeviceSize m_capacity;
+
+	uint64_t m_head = 0; // next free byte
+	uint64_t m_tail = 0; // oldest byte the GPU may still read
+};
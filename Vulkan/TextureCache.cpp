@@ -0,0 +1,333 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "ContentHash.h"
+#include "FastPng.h"
+#include "LoaderSettings.h"
+
+namespace
+{
+    const uint32_t TEXTURE_CACHE_MAGIC = 0x43544B56; // "VKTC"
+    const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+    // Followed by the source path (pathLength bytes) and width * height * 4 bytes of pixels
+    struct TextureCacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint32_t pathLength;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(TextureCacheHeader) == 40, "Texture cache header layout changed");
+}
+
+TextureCache& TextureCache::GetInstance()
+{
+    static TextureCache instance(TEXTURE_CACHE_DIRECTORY, TEXTURE_CACHE_MAX_SIZE);
+    return instance;
+}
+
+TextureCache::TextureCache(const std::string& directory, uint64_t maxSize)
+    : m_directory(directory), m_maxSize(maxSize)
+{
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+
+    uint64_t size = 0;
+    for (const auto& dirEntry : std::filesystem::directory_iterator(m_directory, error))
+    {
+        if (dirEntry.is_regular_file(error) && dirEntry.path().extension() == ".tex")
+            size += dirEntry.file_size(error);
+    }
+    m_size = size;
+}
+
+bool TextureCache::MakeKey(const std::string& fileName, Key* key) const
+{
+    std::error_code error;
+    std::filesystem::path source = std::filesystem::absolute(fileName, error);
+    if (error)
+        return false;
+
+    key->path = source.lexically_normal().generic_string();
+    key->size = std::filesystem::file_size(source, error);
+    if (error)
+        return false;
+    key->time = std::filesystem::last_write_time(source, error).time_since_epoch().count();
+    if (error)
+        return false;
+
+    uint64_t hash = HashBytes(key->path.data(), key->path.size(), key->size ^ static_cast<uint64_t>(key->time));
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.tex", static_cast<unsigned long long>(hash));
+    key->entry = (std::filesystem::path(m_directory) / name).generic_string();
+    return true;
+}
+
+bool TextureCache::OpenEntry(const std::string& fileName, std::ifstream& file, uint32_t* width, uint32_t* height, std::string* entry)
+{
+    Key key;
+    if (!MakeKey(fileName, &key))
+        return false;
+
+    file.open(key.entry, std::ios::binary);
+    TextureCacheHeader header;
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != TEXTURE_CACHE_MAGIC || header.version != TEXTURE_CACHE_VERSION ||
+        header.sourceSize != key.size || header.sourceTime != key.time || header.pathLength != key.path.size())
+    {
+        m_misses++;
+        return false;
+    }
+
+    // Path is stored too, so a hash collision between two files can't hand out the wrong pixels
+    std::string path(header.pathLength, '\0');
+    if (!file.read(&path[0], path.size()) || path != key.path)
+    {
+        m_misses++;
+        return false;
+    }
+
+    *width = header.width;
+    *height = header.height;
+    *entry = key.entry;
+    return true;
+}
+
+void TextureCache::Hit(const std::string& entry)
+{
+    // Reads refresh the entry so trimming drops the ones nobody asked for in the longest time
+    std::error_code error;
+    std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), error);
+    m_hits++;
+}
+
+stbi_uc* TextureCache::Load(const std::string& fileName, int* width, int* height)
+{
+    std::ifstream file;
+    uint32_t entryWidth, entryHeight;
+    std::string entry;
+    if (!OpenEntry(fileName, file, &entryWidth, &entryHeight, &entry))
+        return nullptr;
+
+    size_t size = static_cast<size_t>(entryWidth) * entryHeight * 4;
+    stbi_uc* pixels = static_cast<stbi_uc*>(malloc(size));
+    if (!pixels || !file.read(reinterpret_cast<char*>(pixels), size))
+    {
+        free(pixels);
+        m_misses++;
+        return nullptr;
+    }
+    file.close();
+
+    Hit(entry);
+    *width = static_cast<int>(entryWidth);
+    *height = static_cast<int>(entryHeight);
+    return pixels;
+}
+
+bool TextureCache::LoadInto(const std::string& fileName, uint32_t width, uint32_t height, uint8_t* dst, size_t dstStride)
+{
+    std::ifstream file;
+    uint32_t entryWidth, entryHeight;
+    std::string entry;
+    if (!OpenEntry(fileName, file, &entryWidth, &entryHeight, &entry))
+        return false;
+
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    bool read = entryWidth == width && entryHeight == height;
+    if (read && dstStride == rowSize)
+    {
+        read = static_cast<bool>(file.read(reinterpret_cast<char*>(dst), rowSize * height));
+    }
+    else
+    {
+        for (uint32_t y = 0; read && y < height; y++)
+            read = static_cast<bool>(file.read(reinterpret_cast<char*>(dst + y * dstStride), rowSize));
+    }
+    if (!read)
+    {
+        m_misses++;
+        return false;
+    }
+    file.close();
+
+    Hit(entry);
+    return true;
+}
+
+void TextureCache::Store(const std::string& fileName, const stbi_uc* pixels, int width, int height, size_t stride)
+{
+    Key key;
+    if (!MakeKey(fileName, &key))
+        return;
+
+    TextureCacheHeader header = {};
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.sourceSize = key.size;
+    header.sourceTime = key.time;
+    header.pathLength = static_cast<uint32_t>(key.path.size());
+
+    // Written under a temporary name and renamed, readers never see half a file even with two threads storing the same image
+    std::ostringstream temporaryName;
+    temporaryName << key.entry << "." << std::this_thread::get_id() << ".tmp";
+    std::string temporary = temporaryName.str();
+
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    if (stride == 0)
+        stride = rowSize;
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(key.path.data(), key.path.size());
+        if (stride == rowSize)
+        {
+            file.write(reinterpret_cast<const char*>(pixels), rowSize * height);
+        }
+        else
+        {
+            for (int y = 0; y < height; y++)
+                file.write(reinterpret_cast<const char*>(pixels + y * stride), rowSize);
+        }
+        if (!file)
+        {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+
+    {
+        // An entry that gets replaced was counted already, measure it under the lock so two stores of one image agree
+        std::lock_guard<std::mutex> lock(m_trimMutex);
+
+        std::error_code error;
+        uint64_t replaced = std::filesystem::exists(key.entry, error) ? std::filesystem::file_size(key.entry, error) : 0;
+        if (error)
+            replaced = 0;
+
+        std::filesystem::rename(temporary, key.entry, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+
+        m_size += sizeof(header) + key.path.size() + rowSize * height;
+        m_size -= std::min<uint64_t>(replaced, m_size);
+    }
+    if (m_size > m_maxSize)
+        Trim();
+}
+
+void TextureCache::Trim()
+{
+    std::lock_guard<std::mutex> lock(m_trimMutex);
+
+    struct Entry
+    {
+        std::filesystem::file_time_type time;
+        uint64_t size;
+        std::filesystem::path path;
+    };
+
+    std::error_code error;
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    for (const auto& dirEntry : std::filesystem::directory_iterator(m_directory, error))
+    {
+        if (!dirEntry.is_regular_file(error) || dirEntry.path().extension() != ".tex")
+            continue;
+        Entry entry = { dirEntry.last_write_time(error), dirEntry.file_size(error), dirEntry.path() };
+        entries.push_back(entry);
+        total += entry.size;
+    }
+
+    // Oldest first down to 3/4 of the cap, so the next few stores don't trim again
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+    uint64_t target = m_maxSize / 4 * 3;
+    for (const Entry& entry : entries)
+    {
+        if (total <= target)
+            break;
+        if (std::filesystem::remove(entry.path, error))
+            total -= entry.size;
+    }
+    m_size = total;
+}
+
+stbi_uc* DecodeImageFile(const std::string& fileName, int* width, int* height)
+{
+    if (USE_FAST_PNG)
+        return LoadPngFile(fileName, width, height);
+
+    int channels;
+    return stbi_load(fileName.c_str(), width, height, &channels, STBI_rgb_alpha);
+}
+
+stbi_uc* LoadImageCached(const std::string& fileName, int* width, int* height)
+{
+    if (!USE_TEXTURE_CACHE)
+        return DecodeImageFile(fileName, width, height);
+
+    TextureCache& cache = TextureCache::GetInstance();
+    stbi_uc* pixels = cache.Load(fileName, width, height);
+    if (pixels)
+        return pixels;
+
+    pixels = DecodeImageFile(fileName, width, height);
+    if (pixels)
+        cache.Store(fileName, pixels, *width, *height);
+    return pixels;
+}
+
+
+bool DecodeImageFileInto(const std::string& fileName, uint32_t width, uint32_t height, uint8_t* dst, size_t dstStride)
+{
+    if (USE_FAST_PNG)
+        return LoadPngFileInto(fileName, width, height, dst, dstStride);
+
+    int fileWidth, fileHeight, channels;
+    stbi_uc* pixels = stbi_load(fileName.c_str(), &fileWidth, &fileHeight, &channels, STBI_rgb_alpha);
+    bool matches = pixels && static_cast<uint32_t>(fileWidth) == width && static_cast<uint32_t>(fileHeight) == height;
+    if (matches)
+    {
+        for (uint32_t y = 0; y < height; y++)
+            memcpy(dst + y * dstStride, pixels + static_cast<size_t>(y) * width * 4, static_cast<size_t>(width) * 4);
+    }
+    stbi_image_free(pixels);
+    return matches;
+}
+
+bool LoadImageCachedInto(const std::string& fileName, uint32_t width, uint32_t height, uint8_t* dst, size_t dstStride)
+{
+    if (!USE_TEXTURE_CACHE)
+        return DecodeImageFileInto(fileName, width, height, dst, dstStride);
+
+    TextureCache& cache = TextureCache::GetInstance();
+    if (cache.LoadInto(fileName, width, height, dst, dstStride))
+        return true;
+
+    if (!DecodeImageFileInto(fileName, width, height, dst, dstStride))
+        return false;
+    cache.Store(fileName, dst, static_cast<int>(width), static_cast<int>(height), dstStride);
+    return true;
+}
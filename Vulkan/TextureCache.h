@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include "stb_image.h"
+
+// Decoded RGBA8 of image files kept on disk between runs (TEXTURE_CACHE_DIRECTORY)
+// Entries are keyed by absolute path + file size + modification time, so an edited image simply misses and
+// its old entry ages out. When the directory grows past TEXTURE_CACHE_MAX_SIZE the least recently read entries go first
+// Safe to use from decode threads, every failure (read only disk, full disk...) just means a miss
+class TextureCache
+{
+public:
+	static TextureCache& GetInstance();
+
+	// Pixels are malloc'ed so stbi_image_free releases them like stbi_load output, nullptr on a miss
+	stbi_uc* Load(const std::string& fileName, int* width, int* height);
+	// Into caller memory with rows dstStride apart, also a miss when the entry isn't width x height
+	bool LoadInto(const std::string& fileName, uint32_t width, uint32_t height, uint8_t* dst, size_t dstStride);
+	// stride 0 = rows tightly packed
+	void Store(const std::string& fileName, const stbi_uc* pixels, int width, int height, size_t stride = 0);
+
+	uint64_t GetSize() const { return m_size; }
+	size_t GetHits() const { return m_hits; }
+	size_t GetMisses() const { return m_misses; }
+
+private:
+	TextureCache(const std::string& directory, uint64_t maxSize);
+
+	struct Key
+	{
+		std::string path;   // absolute source path
+		uint64_t size;
+		int64_t time;
+		std::string entry;  // cache file
+	};
+
+	std::string m_directory;
+	uint64_t m_maxSize;
+	std::mutex m_trimMutex; // Trim, and Store replacing an entry
+	std::atomic<uint64_t> m_size = 0;
+	std::atomic<size_t> m_hits = 0;
+	std::atomic<size_t> m_misses = 0;
+
+	bool MakeKey(const std::string& fileName, Key* key) const;
+	// Leaves file at the pixels of fileName's entry, false (counted as a miss) when there is no valid one
+	bool OpenEntry(const std::string& fileName, std::ifstream& file, uint32_t* width, uint32_t* height, std::string* entry);
+	void Hit(const std::string& entry);
+	void Trim();
+};
+
+// stbi_load(..., STBI_rgb_alpha) with FastPng for PNGs when USE_FAST_PNG is on, never cached
+stbi_uc* DecodeImageFile(const std::string& fileName, int* width, int* height);
+bool DecodeImageFileInto(const std::string& fileName, uint32_t width, uint32_t height, uint8_t* dst, size_t dstStride);
+
+// Same through the cache when USE_TEXTURE_CACHE is on, misses are decoded as above
+stbi_uc* LoadImageCached(const std::string& fileName, int* width, int* height);
+// Same straight into caller memory (mapped staging), the size has to be known up front (stbi_info), false when the file doesn't match it
+bool LoadImageCachedInto(const std::string& fileName, uint32_t width, uint32_t height, uint8_t* dst, size_t dstStride);
@@ -0,0 +1,57 @@
+#include "TextureDecode.h"
+
+#include <chrono>
+#include "ContentHash.h"
+#include "LoaderSettings.h"
+#include "TextureCache.h"
+#include "TexturePack.h"
+
+namespace
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    // Adds the time since start to stage and restarts the clock
+    void Lap(Clock::time_point& start, double* stage)
+    {
+        Clock::time_point now = Clock::now();
+        if (stage)
+            *stage += std::chrono::duration<double, std::milli>(now - start).count();
+        start = now;
+    }
+}
+
+bool DecodeTexture(const std::string& fileName, bool cached, uint8_t* dst, uint32_t width, uint32_t height, DecodedTexture* texture, DecodeStageTimes* times)
+{
+    Clock::time_point start = Clock::now();
+    if (dst)
+    {
+        size_t stride = static_cast<size_t>(width) * 4;
+        if (!(cached ? LoadImageCachedInto(fileName, width, height, dst, stride) : DecodeImageFileInto(fileName, width, height, dst, stride)))
+            return false;
+        texture->pixels = dst;
+    }
+    else
+    {
+        int fileWidth, fileHeight;
+        stbi_uc* pixels = cached ? LoadImageCached(fileName, &fileWidth, &fileHeight) : DecodeImageFile(fileName, &fileWidth, &fileHeight);
+        if (!pixels)
+            return false;
+        texture->pixels = pixels;
+        width = static_cast<uint32_t>(fileWidth);
+        height = static_cast<uint32_t>(fileHeight);
+    }
+    texture->width = width;
+    texture->height = height;
+    texture->size = static_cast<uint64_t>(width) * height * 4;
+    Lap(start, times ? &times->decode : nullptr);
+
+    ConvertPixels(texture->pixels, width, height, static_cast<size_t>(width) * 4, TEXTURE_PIXEL_CONVERSIONS);
+    Lap(start, times ? &times->convert : nullptr);
+
+    if (USE_TEXTURE_DEDUPE)
+    {
+        texture->hash = HashTexture(texture->pixels, texture->size, width, height, static_cast<uint32_t>(TexturePackFormat::RGBA8));
+        Lap(start, times ? &times->hash : nullptr);
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// One image file the way the loader threads make it: decoded (FastPng/stb, through the texture cache when cached),
+// TEXTURE_PIXEL_CONVERSIONS applied and hashed for dedupe when USE_TEXTURE_DEDUPE is on
+// AnimationLoader's workers and LoadBench both decode through here
+struct DecodedTexture
+{
+	uint8_t* pixels = nullptr; // dst when decoded into caller memory, otherwise free with stbi_image_free
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t size = 0;
+	uint64_t hash = 0;         // HashTexture of the converted pixels
+};
+
+// Milliseconds per stage, added to on every call
+struct DecodeStageTimes
+{
+	double decode = 0.0;
+	double convert = 0.0;
+	double hash = 0.0;
+};
+
+// dst set: decoded into it (width x height, rows width * 4 apart, e.g. mapped staging), the file has to be that size
+// dst nullptr: decoded into a new buffer, width and height are ignored
+// False when the file can't be read or decoded
+bool DecodeTexture(const std::string& fileName, bool cached, uint8_t* dst, uint32_t width, uint32_t height, DecodedTexture* texture, DecodeStageTimes* times = nullptr);
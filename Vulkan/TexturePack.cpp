@@ -0,0 +1,125 @@
+#include "TexturePack.h"
+
+#include <cstring>
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool TexturePack::Open(const std::string& path)
+{
+    Close();
+
+    if (!m_file.Open(path) || m_file.Size() < sizeof(TexturePackHeader))
+    {
+        Close();
+        return false;
+    }
+
+    memcpy(&m_header, m_file.Data(), sizeof(TexturePackHeader));
+    if (m_header.magic != TEXTURE_PACK_MAGIC || m_header.version != TEXTURE_PACK_VERSION)
+    {
+        Close();
+        return false;
+    }
+
+    // Make sure nothing points outside of the mapping before handing out pointers
+    uint64_t tocEnd = sizeof(TexturePackHeader) + uint64_t(m_header.entryCount) * sizeof(TexturePackEntry);
+    if (tocEnd > m_file.Size() || m_header.nameTableOffset + m_header.nameTableSize > m_file.Size())
+    {
+        Close();
+        return false;
+    }
+
+    auto entries = reinterpret_cast<const TexturePackEntry*>(m_file.Data() + sizeof(TexturePackHeader));
+    for (uint32_t i = 0; i < m_header.entryCount; i++)
+    {
+        if (entries[i].offset + entries[i].size > m_file.Size() ||
+            uint64_t(entries[i].nameOffset) + entries[i].nameLength > m_header.nameTableSize)
+        {
+            Close();
+            return false;
+        }
+    }
+
+    m_entries = entries;
+    m_names = reinterpret_cast<const char*>(m_file.Data() + m_header.nameTableOffset);
+    return true;
+}
+
+void TexturePack::Close()
+{
+    m_file.Close();
+    m_header = {};
+    m_entries = nullptr;
+    m_names = nullptr;
+}
+
+std::string TexturePack::Name(size_t index) const
+{
+    return std::string(m_names + m_entries[index].nameOffset, m_entries[index].nameLength);
+}
+
+bool TexturePackWriter::Begin(const std::string& path, const std::vector<std::string>& names, uint32_t pixelConversions)
+{
+    m_pixelConversions = pixelConversions;
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open())
+        return false;
+
+    m_entries.assign(names.size(), TexturePackEntry{});
+    m_names.clear();
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        m_entries[i].nameOffset = static_cast<uint32_t>(m_names.size());
+        m_entries[i].nameLength = static_cast<uint32_t>(names[i].size());
+        m_names += names[i];
+    }
+
+    // Pixel data starts after header, table of contents and names
+    m_writeOffset = sizeof(TexturePackHeader) + m_entries.size() * sizeof(TexturePackEntry) + m_names.size();
+    return true;
+}
+
+bool TexturePackWriter::AddImage(size_t index, uint32_t width, uint32_t height, TexturePackFormat format, uint32_t mipLevels, const void* data, uint64_t size)
+{
+    if (index >= m_entries.size())
+        return false;
+
+    m_writeOffset = AlignUp(m_writeOffset, TEXTURE_PACK_ALIGNMENT);
+
+    TexturePackEntry& entry = m_entries[index];
+    entry.width = width;
+    entry.height = height;
+    entry.format = static_cast<uint32_t>(format);
+    entry.mipLevels = mipLevels;
+    entry.offset = m_writeOffset;
+    entry.size = size;
+
+    m_file.seekp(static_cast<std::streamoff>(m_writeOffset));
+    m_file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    m_writeOffset += size;
+
+    return m_file.good();
+}
+
+bool TexturePackWriter::Finish()
+{
+    TexturePackHeader header = {};
+    header.magic = TEXTURE_PACK_MAGIC;
+    header.version = TEXTURE_PACK_VERSION;
+    header.entryCount = static_cast<uint32_t>(m_entries.size());
+    header.pixelConversions = m_pixelConversions;
+    header.nameTableOffset = sizeof(TexturePackHeader) + m_entries.size() * sizeof(TexturePackEntry);
+    header.nameTableSize = m_names.size();
+
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.write(reinterpret_cast<const char*>(m_entries.data()), static_cast<std::streamsize>(m_entries.size() * sizeof(TexturePackEntry)));
+    m_file.write(m_names.data(), static_cast<std::streamsize>(m_names.size()));
+
+    bool good = m_file.good();
+    m_file.close();
+    return good;
+}
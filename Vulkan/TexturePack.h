@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// Pre-decoded texture pack (*.pack), written offline by TexturePacker
+// Layout: header | table of contents | name table | pixel blobs (each aligned to TEXTURE_PACK_ALIGNMENT)
+// All values are little endian
+
+const uint32_t TEXTURE_PACK_MAGIC = 0x50544B56; // "VKTP"
+const uint32_t TEXTURE_PACK_VERSION = 1;
+const uint64_t TEXTURE_PACK_ALIGNMENT = 256;
+
+enum class TexturePackFormat : uint32_t
+{
+	RGBA8 = 0,
+	BC1 = 1, // RGB + 1 bit alpha, 8 bytes per 4x4 block
+	BC3 = 2  // RGBA, 16 bytes per 4x4 block
+};
+
+struct TexturePackHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t pixelConversions; // PixelConversion bits applied before storing (premultiplied alpha...)
+	uint64_t nameTableOffset;
+	uint64_t nameTableSize;
+};
+
+struct TexturePackEntry
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;      // TexturePackFormat
+	uint32_t mipLevels;   // levels stored back to back in the blob, 1 = base level only
+	uint64_t offset;      // from start of file
+	uint64_t size;        // size of the blob in bytes
+	uint32_t nameOffset;  // into name table
+	uint32_t nameLength;
+};
+
+static_assert(sizeof(TexturePackHeader) == 32, "Texture pack header layout changed");
+static_assert(sizeof(TexturePackEntry) == 40, "Texture pack entry layout changed");
+
+// Reader, maps the pack and hands out pointers straight into the mapping
+class TexturePack
+{
+public:
+	bool Open(const std::string& path);
+	void Close();
+
+	size_t Count() const { return m_entries ? m_header.entryCount : 0; }
+	const TexturePackEntry& Entry(size_t index) const { return m_entries[index]; }
+	std::string Name(size_t index) const;
+	uint32_t PixelConversions() const { return m_header.pixelConversions; }
+	const uint8_t* Pixels(size_t index) const { return m_file.Data() + m_entries[index].offset; }
+
+private:
+	MappedFile m_file;
+	TexturePackHeader m_header = {};
+	const TexturePackEntry* m_entries = nullptr;
+	const char* m_names = nullptr;
+};
+
+// Writer, names are known up front so the table of contents can be reserved
+// Blobs are appended in any order and the table is written on Finish
+class TexturePackWriter
+{
+public:
+	bool Begin(const std::string& path, const std::vector<std::string>& names, uint32_t pixelConversions = 0);
+	bool AddImage(size_t index, uint32_t width, uint32_t height, TexturePackFormat format, uint32_t mipLevels, const void* data, uint64_t size);
+	bool Finish();
+
+private:
+	std::ofstream m_file;
+	std::vector<TexturePackEntry> m_entries;
+	std::string m_names;
+	uint64_t m_writeOffset = 0;
+	uint32_t m_pixelConversions = 0;
+};
@@ -0,0 +1,150 @@
+#include "TextureRegistry.h"
+
+#include <algorithm>
+
+int TextureRegistry::Find(const std::string& path) const
+{
+    std::string key = MakeKey(path);
+    const Shard& shard = GetShard(key);
+
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto found = shard.ids.find(key);
+    return found != shard.ids.end() ? found->second : IN_FLIGHT;
+}
+
+int TextureRegistry::GetOrLoad(const std::string& path, const std::function<int()>& create)
+{
+    std::string key = MakeKey(path);
+    Shard& shard = GetShard(key);
+
+    {
+        std::unique_lock<std::mutex> lock(shard.lock);
+        for (;;)
+        {
+            auto found = shard.ids.find(key);
+            if (found == shard.ids.end())
+            {
+                shard.ids.emplace(key, IN_FLIGHT);
+                break;
+            }
+            if (found->second != IN_FLIGHT)
+                return found->second;
+
+            // Someone else is creating it
+            shard.created.wait(lock);
+        }
+    }
+
+    int texId;
+    try
+    {
+        texId = create();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        shard.ids.erase(key);
+        shard.created.notify_all();
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock(shard.lock);
+    shard.ids[key] = texId;
+    shard.created.notify_all();
+    return texId;
+}
+
+void TextureRegistry::Remove(const std::string& path)
+{
+    std::string key = MakeKey(path);
+    Shard& shard = GetShard(key);
+
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto found = shard.ids.find(key);
+    if (found != shard.ids.end() && found->second != IN_FLIGHT)
+        shard.ids.erase(found);
+}
+
+size_t TextureRegistry::GetCount() const
+{
+    size_t count = 0;
+    for (const Shard& shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        count += std::count_if(shard.ids.begin(), shard.ids.end(), [](const std::pair<const std::string, int>& entry) { return entry.second != IN_FLIGHT; });
+    }
+    return count;
+}
+
+bool TextureRegistry::FindContent(uint64_t hash, ContentLocation* location) const
+{
+    std::lock_guard<std::mutex> lock(m_contentLock);
+    auto found = m_contents.find(hash);
+    if (found == m_contents.end())
+        return false;
+
+    *location = found->second;
+    return true;
+}
+
+void TextureRegistry::RegisterContent(uint64_t hash, const ContentLocation& location)
+{
+    std::lock_guard<std::mutex> lock(m_contentLock);
+    if (m_contents.emplace(hash, location).second)
+        m_contentsByTexture[location.texId].push_back(hash);
+}
+
+void TextureRegistry::ForgetContent(int texId)
+{
+    std::lock_guard<std::mutex> lock(m_contentLock);
+    auto found = m_contentsByTexture.find(texId);
+    if (found == m_contentsByTexture.end())
+        return;
+
+    for (uint64_t hash : found->second)
+        m_contents.erase(hash);
+    m_contentsByTexture.erase(found);
+}
+
+void TextureRegistry::MarkShared(int texId)
+{
+    std::lock_guard<std::mutex> lock(m_contentLock);
+    m_sharedTextures.insert(texId);
+}
+
+bool TextureRegistry::IsShared(int texId) const
+{
+    std::lock_guard<std::mutex> lock(m_contentLock);
+    return m_sharedTextures.count(texId) != 0;
+}
+
+void TextureRegistry::Clear()
+{
+    for (Shard& shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        shard.ids.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(m_contentLock);
+    m_contents.clear();
+    m_contentsByTexture.clear();
+    m_sharedTextures.clear();
+}
+
+std::string TextureRegistry::MakeKey(const std::string& path)
+{
+    std::string key = path;
+    std::replace(key.begin(), key.end(), '\\', '/');
+    return key;
+}
+
+TextureRegistry::Shard& TextureRegistry::GetShard(const std::string& key)
+{
+    return m_shards[std::hash<std::string>()(key) % SHARD_COUNT];
+}
+
+const TextureRegistry::Shard& TextureRegistry::GetShard(const std::string& key) const
+{
+    return m_shards[std::hash<std::string>()(key) % SHARD_COUNT];
+}
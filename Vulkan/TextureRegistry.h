@@ -0,0 +1,81 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "TextureResidency.h"
+
+// Texture path -> texId, and content hash -> where those pixels already are, safe to use from any thread
+// Paths are spread over shards with their own lock, so threads looking up different paths rarely meet
+// A path being created is marked in flight, everyone else asking for it waits for that one result instead of loading it again
+class TextureRegistry
+{
+public:
+	TextureRegistry() = default;
+
+	TextureRegistry(const TextureRegistry&) = delete;
+	TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+	// -1 when the path isn't registered or is still being created
+	int Find(const std::string& path) const;
+
+	// Registered id, otherwise create runs on the calling thread (no lock held) and its result is registered
+	// If create throws the path is free again and one of the waiting callers runs its own create
+	// create must not ask for the same path, it would wait for itself
+	int GetOrLoad(const std::string& path, const std::function<int()>& create);
+
+	size_t GetCount() const;
+
+	// Forgets a registered path so the next GetOrLoad creates it again, nothing happens while it is in flight
+	void Remove(const std::string& path);
+
+	// Texture and array layer already holding some pixels, source is where they can be read again to rule out a collision
+	struct ContentLocation
+	{
+		int texId;
+		int layer;
+		TextureLayerSource source;
+	};
+
+	// Content hash (HashTexture) lookups for dedupe, the first location registered for a hash stays
+	bool FindContent(uint64_t hash, ContentLocation* location) const;
+	void RegisterContent(uint64_t hash, const ContentLocation& location);
+	// The texture's pixels changed, nothing may be deduped against it any more
+	void ForgetContent(int texId);
+
+	// Dedupe handed the texture to frames (and paths) that didn't load it, changing its pixels would change all of them
+	void MarkShared(int texId);
+	bool IsShared(int texId) const;
+
+	// The textures are gone, forget every path and hash
+	void Clear();
+
+private:
+	static constexpr size_t SHARD_COUNT = 16;
+	static constexpr int IN_FLIGHT = -1;
+
+	struct Shard
+	{
+		mutable std::mutex lock;
+		std::condition_variable created;
+		std::unordered_map<std::string, int> ids; // IN_FLIGHT while create runs
+	};
+
+	Shard m_shards[SHARD_COUNT];
+
+	mutable std::mutex m_contentLock;
+	std::unordered_map<uint64_t, ContentLocation> m_contents;
+	std::unordered_map<int, std::vector<uint64_t>> m_contentsByTexture; // texId -> its hashes in m_contents
+	std::unordered_set<int> m_sharedTextures;
+
+	// Both separators name the same file on Windows
+	static std::string MakeKey(const std::string& path);
+	Shard& GetShard(const std::string& key);
+	const Shard& GetShard(const std::string& key) const;
+};
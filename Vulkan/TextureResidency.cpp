@@ -0,0 +1,177 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include "TextureCache.h"
+#include "Utilites.h"
+
+void StreamedTexture::Release()
+{
+    for (stbi_uc* pixels : decoded)
+        stbi_image_free(pixels);
+    decoded.clear();
+    layers.clear();
+}
+
+TextureResidency::TextureResidency(uint64_t budget)
+    : m_budget(budget)
+{
+    m_streamer = std::thread(&TextureResidency::StreamWorker, this);
+}
+
+TextureResidency::~TextureResidency()
+{
+    m_requests.Close();
+    m_streamer.join();
+
+    // Whatever came back after the last frame is dropped
+    StreamedTexture texture;
+    while (m_streamed.TryPop(texture))
+        texture.Release();
+}
+
+TextureResidency::Texture& TextureResidency::Get(int texId)
+{
+    if (texId >= static_cast<int>(m_textures.size()))
+        m_textures.resize(texId + 1);
+    return m_textures[texId];
+}
+
+void TextureResidency::SetSource(int texId, uint32_t layer, TextureLayerSource source)
+{
+    Texture& texture = Get(texId);
+    if (layer >= texture.layers.size())
+        texture.layers.resize(layer + 1);
+    texture.layers[layer] = std::move(source);
+}
+
+void TextureResidency::MakeResident(int texId, uint64_t size, uint32_t width, uint32_t height, uint32_t layerCount, uint64_t frame)
+{
+    Texture& texture = Get(texId);
+    if (!texture.resident)
+        m_residentBytes += size;
+    texture.size = size;
+    texture.width = width;
+    texture.height = height;
+    texture.layerCount = layerCount;
+    texture.lastUsed = frame;
+    texture.resident = true;
+    texture.streaming = false;
+}
+
+void TextureResidency::MakeEvicted(int texId)
+{
+    Texture& texture = Get(texId);
+    if (!texture.resident)
+        return;
+
+    m_residentBytes -= texture.size;
+    texture.resident = false;
+    m_evictionCount++;
+}
+
+void TextureResidency::StreamFailed(int texId)
+{
+    Texture& texture = Get(texId);
+    texture.streaming = false;
+    texture.layers.clear();
+}
+
+void TextureResidency::Touch(int texId, uint64_t frame)
+{
+    Texture& texture = Get(texId);
+    texture.lastUsed = frame;
+    texture.lastDrawn = frame;
+
+    if (texture.resident || texture.streaming || !IsEvictable(texture))
+        return;
+
+    texture.streaming = true;
+    m_streamCount++;
+    m_requests.Push({ texId, texture.width, texture.height, texture.layers });
+}
+
+void TextureResidency::Pin(int texId)
+{
+    Get(texId).pinned = true;
+}
+
+bool TextureResidency::IsEvictable(const Texture& texture) const
+{
+    if (texture.pinned || texture.layerCount == 0 || texture.layers.size() != texture.layerCount)
+        return false;
+    return std::all_of(texture.layers.begin(), texture.layers.end(), [](const TextureLayerSource& layer) { return layer.IsValid(); });
+}
+
+std::vector<int> TextureResidency::CollectEvictions(uint64_t completedFrames) const
+{
+    std::vector<int> evictions;
+    if (m_residentBytes <= m_budget)
+        return evictions;
+
+    std::vector<int> candidates;
+    for (size_t texId = 0; texId < m_textures.size(); texId++)
+    {
+        const Texture& texture = m_textures[texId];
+        if (!texture.resident || !IsEvictable(texture))
+            continue;
+        if (texture.lastDrawn != NEVER_DRAWN && texture.lastDrawn >= completedFrames)
+            continue;
+        candidates.push_back(static_cast<int>(texId));
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [this](int a, int b) { return m_textures[a].lastUsed < m_textures[b].lastUsed; });
+
+    // Can stay over budget when everything left is in use, the next frame tries again
+    uint64_t residentBytes = m_residentBytes;
+    for (int texId : candidates)
+    {
+        if (residentBytes <= m_budget)
+            break;
+        residentBytes -= m_textures[texId].size;
+        evictions.push_back(texId);
+    }
+    return evictions;
+}
+
+void TextureResidency::StreamWorker()
+{
+    StreamRequest request;
+    while (m_requests.Pop(request))
+    {
+        StreamedTexture texture;
+        texture.texId = request.texId;
+        for (const TextureLayerSource& layer : request.layers)
+        {
+            if (layer.pack)
+            {
+                const TexturePackEntry& entry = layer.pack->Entry(layer.entry);
+                if (entry.width != request.width || entry.height != request.height)
+                {
+                    texture.failed = true;
+                    break;
+                }
+                texture.layers.push_back(layer.pack->Pixels(layer.entry));
+                continue;
+            }
+
+            int width, height;
+            stbi_uc* pixels = LoadImageCached(layer.fileName, &width, &height);
+            if (!pixels)
+            {
+                texture.failed = true;
+                break;
+            }
+            // File changed on disk since the upload, the image and staging copies are sized for the old extent
+            if (static_cast<uint32_t>(width) != request.width || static_cast<uint32_t>(height) != request.height)
+            {
+                stbi_image_free(pixels);
+                texture.failed = true;
+                break;
+            }
+            ConvertPixels(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), static_cast<size_t>(width) * 4, TEXTURE_PIXEL_CONVERSIONS);
+            texture.decoded.push_back(pixels);
+            texture.layers.push_back(pixels);
+        }
+        m_streamed.Push(std::move(texture));
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "stb_image.h"
+#include "TexturePack.h"
+#include "WorkQueue.h"
+
+// Where one layer of a texture can be read again after it was evicted, either a pack entry or an image file
+struct TextureLayerSource
+{
+	std::shared_ptr<TexturePack> pack;
+	size_t entry = 0;
+	std::string fileName;
+
+	bool IsValid() const { return pack || !fileName.empty(); }
+};
+
+// Layers read back by the streaming thread, pack layers point into the mapping, file layers are decoded RGBA8
+// failed is set when a source can't be read or no longer has the extent the texture was created with
+struct StreamedTexture
+{
+	int texId = -1;
+	std::vector<const uint8_t*> layers;
+	std::vector<stbi_uc*> decoded;
+	bool failed = false;
+
+	void Release();
+};
+
+// Keeps track of which textures are in VRAM and how recently they were drawn
+// Over budget the least recently drawn ones are picked for eviction, drawing an evicted texture queues it
+// for the streaming thread which reads its layers again, the renderer uploads them when they come back
+// Only textures with a source for every layer can be evicted, the rest (placeholder, textures made from memory) are pinned
+class TextureResidency
+{
+public:
+	explicit TextureResidency(uint64_t budget);
+	~TextureResidency();
+
+	TextureResidency(const TextureResidency&) = delete;
+	TextureResidency& operator=(const TextureResidency&) = delete;
+
+	void SetSource(int texId, uint32_t layer, TextureLayerSource source);
+
+	// Texture is uploaded and takes size bytes of VRAM, width and height are what streamed layers have to match
+	void MakeResident(int texId, uint64_t size, uint32_t width, uint32_t height, uint32_t layerCount, uint64_t frame);
+	void MakeEvicted(int texId);
+	// Source couldn't be read, texture stays on the placeholder and is never requested again
+	void StreamFailed(int texId);
+	bool IsResident(int texId) const { return texId < static_cast<int>(m_textures.size()) && m_textures[texId].resident; }
+
+	// Called for every draw, queues a stream request when the texture isn't resident
+	void Touch(int texId, uint64_t frame);
+
+	// Never evicted, for the placeholder itself
+	void Pin(int texId);
+
+	// Least recently used textures to evict until the resident bytes fit the budget
+	// Frames below completedFrames have finished on the GPU, textures drawn since then are skipped
+	std::vector<int> CollectEvictions(uint64_t completedFrames) const;
+
+	// Non blocking, caller uploads the layers and calls Release
+	bool PopStreamed(StreamedTexture& texture) { return m_streamed.TryPop(texture); }
+
+	void SetBudget(uint64_t budget) { m_budget = budget; }
+	uint64_t GetBudget() const { return m_budget; }
+	uint64_t GetResidentBytes() const { return m_residentBytes; }
+	size_t GetEvictionCount() const { return m_evictionCount; }
+	size_t GetStreamCount() const { return m_streamCount; }
+
+private:
+	static const uint64_t NEVER_DRAWN = UINT64_MAX;
+
+	struct Texture
+	{
+		uint64_t size = 0;
+		uint64_t lastUsed = 0;              // last draw, or when it was uploaded
+		uint64_t lastDrawn = NEVER_DRAWN;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t layerCount = 0;
+		bool resident = false;
+		bool streaming = false;
+		bool pinned = false;
+		std::vector<TextureLayerSource> layers;
+	};
+
+	struct StreamRequest
+	{
+		int texId;
+		uint32_t width;
+		uint32_t height;
+		std::vector<TextureLayerSource> layers;
+	};
+
+	std::vector<Texture> m_textures;
+	uint64_t m_budget;
+	uint64_t m_residentBytes = 0;
+	size_t m_evictionCount = 0;
+	size_t m_streamCount = 0;
+
+	WorkQueue<StreamRequest> m_requests;
+	WorkQueue<StreamedTexture> m_streamed;
+	std::thread m_streamer;
+
+	Texture& Get(int texId);
+	bool IsEvictable(const Texture& texture) const;
+	void StreamWorker();
+};
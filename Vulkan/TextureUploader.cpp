@@ -0,0 +1,166 @@
+#include "TextureUploader.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "BlockCompression.h"
+#include "MipMaps.h"
+#include "Utilites.h"
+
+static VkFormat PackFormatToVkFormat(TexturePackFormat format)
+{
+    switch (format)
+    {
+    case TexturePackFormat::BC1: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case TexturePackFormat::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+    default: return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+TextureUploader::TextureUploader(VkPhysicalDevice physicalDevice, VkDevice device, DeviceAllocator& allocator, UploadBatch& uploadBatch, bool textureCompressionBC)
+    : m_device(device), m_allocator(allocator), m_uploadBatch(uploadBatch)
+{
+    // Mips are blitted on the GPU when the texture format supports linear filtered blits, otherwise made on the CPU
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    m_blitMipmaps = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+
+    // Block compressed formats need the device feature and sampling support for the format itself
+    m_sampledFormats = 1u << static_cast<uint32_t>(TexturePackFormat::RGBA8);
+    for (TexturePackFormat format : { TexturePackFormat::BC1, TexturePackFormat::BC3 })
+    {
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, PackFormatToVkFormat(format), &formatProperties);
+        if (textureCompressionBC && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+            m_sampledFormats |= 1u << static_cast<uint32_t>(format);
+    }
+}
+
+TextureInfo TextureUploader::MakeInfo(uint32_t width, uint32_t height, uint32_t layerCount, TexturePackFormat format, uint32_t storedLevels) const
+{
+    TextureInfo info = { width, height, layerCount, 1, format, VK_FORMAT_R8G8B8A8_UNORM };
+
+    if (IsBlockCompressed(format) && IsFormatSupported(format))
+    {
+        // Compressed images can't be blitted, the chain has to come with the data
+        info.imageFormat = PackFormatToVkFormat(format);
+        info.mipLevels = GENERATE_MIPMAPS ? std::max(1u, storedLevels) : 1;
+        return info;
+    }
+
+    info.mipLevels = GENERATE_MIPMAPS ? MipLevelCount(width, height) : 1;
+    return info;
+}
+
+VkImage TextureUploader::CreateImage(const TextureInfo& info, DeviceAllocation* memory)
+{
+    VkImageCreateInfo imageCreateInfo = {};
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.extent = { info.width, info.height, 1 };
+    imageCreateInfo.mipLevels = info.mipLevels;
+    imageCreateInfo.arrayLayers = info.layerCount;
+    imageCreateInfo.format = info.imageFormat;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    // Blitted mips read from the level above
+    imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (info.imageFormat == VK_FORMAT_R8G8B8A8_UNORM && info.mipLevels > 1 && m_blitMipmaps)
+        imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+    VkImage image;
+    if (vkCreateImage(m_device, &imageCreateInfo, nullptr, &image) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create an image");
+    }
+
+    // Memory comes from the sub-allocator, big images get a dedicated allocation there
+    *memory = m_allocator.BindImage(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    return image;
+}
+
+VkImageView TextureUploader::CreateView(VkImage image, const TextureInfo& info)
+{
+    VkImageViewCreateInfo viewCreateInfo = {};
+    viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewCreateInfo.image = image;
+    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewCreateInfo.format = info.imageFormat;
+    viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+    viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, info.mipLevels, 0, info.layerCount };
+
+    VkImageView view;
+    if (vkCreateImageView(m_device, &viewCreateInfo, nullptr, &view) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create an image view");
+    }
+    return view;
+}
+
+void TextureUploader::EnqueueLayer(VkImage image, const TextureInfo& info, uint32_t layer, const uint8_t* pixels)
+{
+    if (info.imageFormat != VK_FORMAT_R8G8B8A8_UNORM)
+    {
+        // Compressed straight from the pack, every level is already there
+        for (uint32_t level = 0; level < info.mipLevels; level++)
+        {
+            uint32_t levelWidth = std::max(1u, info.width >> level);
+            uint32_t levelHeight = std::max(1u, info.height >> level);
+            VkDeviceSize levelSize = TextureLevelSize(info.format, levelWidth, levelHeight);
+            m_uploadBatch.EnqueueImageCopy(pixels, levelSize, image, levelWidth, levelHeight, layer, 1, level);
+            pixels += levelSize;
+        }
+        return;
+    }
+
+    // Device can't sample the compressed format, decode level 0 and treat it like any RGBA8 layer
+    std::vector<uint8_t> decoded;
+    if (IsBlockCompressed(info.format))
+    {
+        decoded.resize(static_cast<size_t>(info.width) * info.height * 4);
+        DecompressImage(info.format, pixels, info.width, info.height, decoded.data());
+        pixels = decoded.data();
+    }
+
+    VkDeviceSize layerSize = static_cast<VkDeviceSize>(info.width) * info.height * 4;
+    m_uploadBatch.EnqueueImageCopy(pixels, layerSize, image, info.width, info.height, layer, 1);
+
+    if (info.mipLevels == 1 || m_blitMipmaps)
+        return;
+
+    // No linear blit for the format, box filter the chain here and upload every level
+    std::vector<size_t> offsets;
+    std::vector<uint8_t> chain = GenerateMipChain(pixels, info.width, info.height, info.mipLevels, &offsets);
+    for (uint32_t level = 1; level < info.mipLevels; level++)
+    {
+        uint32_t levelWidth = std::max(1u, info.width >> level);
+        uint32_t levelHeight = std::max(1u, info.height >> level);
+        m_uploadBatch.EnqueueImageCopy(chain.data() + offsets[level - 1], static_cast<VkDeviceSize>(levelWidth) * levelHeight * 4, image, levelWidth, levelHeight, layer, 1, level);
+    }
+}
+
+void TextureUploader::EnqueueFinish(VkImage image, const TextureInfo& info)
+{
+    if (info.imageFormat == VK_FORMAT_R8G8B8A8_UNORM && info.mipLevels > 1 && m_blitMipmaps)
+        m_uploadBatch.EnqueueMipGeneration(image, info.width, info.height, info.layerCount, info.mipLevels);
+    else
+        m_uploadBatch.EnqueueImageTransition(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, info.layerCount, info.mipLevels);
+}
+
+VkImage TextureUploader::Upload(const TextureInfo& info, const uint8_t* pixels, DeviceAllocation* memory, bool onTransferQueue)
+{
+    VkImage image = CreateImage(info, memory);
+    if (onTransferQueue)
+        m_uploadBatch.UploadOnTransferQueue(image);
+
+    // Transition, copy and transition back are recorded into the current batch
+    m_uploadBatch.Begin();
+    m_uploadBatch.EnqueueImageTransition(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, info.layerCount, info.mipLevels);
+    EnqueueLayer(image, info, 0, pixels);
+    EnqueueFinish(image, info);
+    m_uploadBatch.End();
+    return image;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include "DeviceAllocator.h"
+#include "TexturePack.h"
+#include "UploadBatch.h"
+
+struct TextureInfo
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t layerCount;
+	uint32_t mipLevels;
+	TexturePackFormat format; // format of the pixels handed to the upload functions
+	VkFormat imageFormat;     // format of the image, RGBA8 when a compressed format has to be decoded
+};
+
+// Texture images and what goes into the upload batch for them: format and mip choice, image creation, every level of a
+// layer (BC decode and CPU mips when the device needs them) and the blits/transition that finish the image
+// VulkanRenderer and LoadBench both upload through here, descriptors stay with the caller
+class TextureUploader
+{
+public:
+	// textureCompressionBC: whether the device feature was enabled
+	TextureUploader(VkPhysicalDevice physicalDevice, VkDevice device, DeviceAllocator& allocator, UploadBatch& uploadBatch, bool textureCompressionBC);
+
+	TextureUploader(const TextureUploader&) = delete;
+	TextureUploader& operator=(const TextureUploader&) = delete;
+
+	bool IsFormatSupported(TexturePackFormat format) const { return (m_sampledFormats >> static_cast<uint32_t>(format)) & 1; }
+	// Device can blit RGBA8 with linear filter, otherwise mips come from MipMaps.h
+	bool GetBlitMipmaps() const { return m_blitMipmaps; }
+
+	// storedLevels: levels that come with compressed data, RGBA8 chains are always made here
+	TextureInfo MakeInfo(uint32_t width, uint32_t height, uint32_t layerCount, TexturePackFormat format, uint32_t storedLevels) const;
+	// Device local, still in UNDEFINED layout
+	VkImage CreateImage(const TextureInfo& info, DeviceAllocation* memory);
+	// Every texture is viewed as an array (of 1 layer) so the same sampler2DArray reads single textures and animation arrays
+	VkImageView CreateView(VkImage image, const TextureInfo& info);
+
+	// The image has to be in TRANSFER_DST, pixels are copied to staging before this returns
+	void EnqueueLayer(VkImage image, const TextureInfo& info, uint32_t layer, const uint8_t* pixels);
+	// Blitted mips or a plain transition, the image ends in SHADER_READ_ONLY
+	void EnqueueFinish(VkImage image, const TextureInfo& info);
+	// CreateImage + a whole single layer texture queued into the current batch
+	// onTransferQueue when the caller only draws it after IsSubmitComplete, see UploadBatch::UploadOnTransferQueue
+	VkImage Upload(const TextureInfo& info, const uint8_t* pixels, DeviceAllocation* memory, bool onTransferQueue = false);
+
+private:
+	VkDevice m_device;
+	DeviceAllocator& m_allocator;
+	UploadBatch& m_uploadBatch;
+	bool m_blitMipmaps = false;
+	uint32_t m_sampledFormats = 0; // bit per TexturePackFormat the device can sample directly
+};
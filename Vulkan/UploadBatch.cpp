@@ -0,0 +1,699 @@
+#include "UploadBatch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include "Utilites.h"
+
+// Copy offsets must be a multiple of the texel size, 16 covers every format we upload
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+// Uploaded buffers are read as vertices, indices or indirect draw commands/counts
+static const VkAccessFlags BUFFER_READ_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+static const VkPipelineStageFlags BUFFER_READ_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+
+static VkAccessFlags LayoutAccess(VkImageLayout layout)
+{
+    switch (layout)
+    {
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return VK_ACCESS_TRANSFER_WRITE_BIT;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return VK_ACCESS_TRANSFER_READ_BIT;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return VK_ACCESS_SHADER_READ_BIT;
+    default: return 0;
+    }
+}
+
+static VkImageMemoryBarrier MakeImageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount, uint32_t baseMipLevel = 0, uint32_t levelCount = 1, uint32_t baseArrayLayer = 0)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = baseMipLevel;
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.subresourceRange.baseArrayLayer = baseArrayLayer;
+    barrier.subresourceRange.layerCount = layerCount;
+
+    barrier.srcAccessMask = LayoutAccess(oldLayout);
+    barrier.dstAccessMask = LayoutAccess(newLayout);
+    return barrier;
+}
+
+static void QueueSubmit(VkQueue queue, VkCommandBuffer commandBuffer, VkFence fence)
+{
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit upload batch");
+}
+
+UploadBatch::UploadBatch(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, VkCommandPool commandPool)
+    : m_physicalDevice(physicalDevice), m_device(device), m_queue(queue), m_commandPool(commandPool), m_ring(physicalDevice, device, STAGING_RING_SIZE)
+{
+}
+
+UploadBatch::~UploadBatch()
+{
+    // Nothing may still read staging memory when it is freed, acquires still waiting are never submitted
+    for (auto& submit : m_inFlight)
+    {
+        for (VkFence fence : { submit.fence, submit.transferFence, submit.acquireFence })
+        {
+            if (fence == VK_NULL_HANDLE)
+                continue;
+            vkWaitForFences(m_device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            vkDestroyFence(m_device, fence, nullptr);
+        }
+        FreeCommandBuffers(submit);
+        for (auto& staging : submit.dedicated)
+        {
+            vkDestroyBuffer(m_device, staging.buffer, nullptr);
+            vkFreeMemory(m_device, staging.memory, nullptr);
+        }
+    }
+    for (auto& staging : m_dedicated)
+    {
+        vkDestroyBuffer(m_device, staging.buffer, nullptr);
+        vkFreeMemory(m_device, staging.memory, nullptr);
+    }
+    for (auto fence : m_freeFences)
+        vkDestroyFence(m_device, fence, nullptr);
+}
+
+void UploadBatch::FreeCommandBuffers(const InFlight& submit)
+{
+    if (submit.commandBuffer != VK_NULL_HANDLE)
+        vkFreeCommandBuffers(m_device, m_commandPool, 1, &submit.commandBuffer);
+    if (submit.transferCommandBuffer != VK_NULL_HANDLE)
+        vkFreeCommandBuffers(m_device, m_transferCommandPool, 1, &submit.transferCommandBuffer);
+    if (submit.acquireCommandBuffer != VK_NULL_HANDLE)
+        vkFreeCommandBuffers(m_device, m_commandPool, 1, &submit.acquireCommandBuffer);
+}
+
+void UploadBatch::Begin()
+{
+    m_depth++;
+}
+
+void UploadBatch::End()
+{
+    if (m_depth == 0)
+        throw std::runtime_error("UploadBatch::End without Begin");
+
+    if (--m_depth == 0)
+        Submit();
+}
+
+void UploadBatch::EnqueueBufferCopy(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset)
+{
+    StagingRing::Allocation staging = AllocateStaging(size);
+    memcpy(staging.mapped, data, static_cast<size_t>(size));
+
+    BufferCopy copy = {};
+    copy.srcBuffer = staging.buffer;
+    copy.dstBuffer = dstBuffer;
+    copy.region.srcOffset = staging.offset;
+    copy.region.dstOffset = dstOffset;
+    copy.region.size = size;
+    m_bufferCopies.push_back(copy);
+}
+
+void UploadBatch::EnqueueImageCopy(const void* data, VkDeviceSize size, VkImage image, uint32_t width, uint32_t height, uint32_t baseArrayLayer, uint32_t layerCount, uint32_t mipLevel)
+{
+    StagingRing::Allocation staging = AllocateStaging(size);
+    memcpy(staging.mapped, data, static_cast<size_t>(size));
+
+    // Layers are tightly packed one after another in the staging memory
+    ImageCopy copy = {};
+    copy.srcBuffer = staging.buffer;
+    copy.image = image;
+    copy.region.bufferOffset = staging.offset;
+    copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.region.imageSubresource.mipLevel = mipLevel;
+    copy.region.imageSubresource.baseArrayLayer = baseArrayLayer;
+    copy.region.imageSubresource.layerCount = layerCount;
+    copy.region.imageOffset = { 0, 0, 0 };
+    copy.region.imageExtent = { width, height, 1 };
+    m_imageCopies.push_back(copy);
+}
+
+void UploadBatch::EnqueueImageRegionCopy(const void* data, size_t rowPitch, VkImage image, int32_t x, int32_t y, uint32_t width, uint32_t height, uint32_t arrayLayer, uint32_t mipLevel)
+{
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    StagingRing::Allocation staging = AllocateStaging(rowSize * height);
+
+    // Rows are packed tightly in staging whatever the source pitch
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    if (rowPitch == rowSize)
+    {
+        memcpy(staging.mapped, src, rowSize * height);
+    }
+    else
+    {
+        for (uint32_t row = 0; row < height; row++)
+            memcpy(staging.mapped + row * rowSize, src + row * rowPitch, rowSize);
+    }
+
+    ImageCopy copy = {};
+    copy.srcBuffer = staging.buffer;
+    copy.image = image;
+    copy.region.bufferOffset = staging.offset;
+    copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.region.imageSubresource.mipLevel = mipLevel;
+    copy.region.imageSubresource.baseArrayLayer = arrayLayer;
+    copy.region.imageSubresource.layerCount = 1;
+    copy.region.imageOffset = { x, y, 0 };
+    copy.region.imageExtent = { width, height, 1 };
+    m_imageCopies.push_back(copy);
+}
+
+bool UploadBatch::ReserveImageWrite(VkDeviceSize size, ImageWrite* write)
+{
+    // Reservations can sit in the ring for a while, keep half of it for everything else
+    if (m_reservedBytes + size > m_ring.GetCapacity() / 2)
+        return false;
+
+    StagingRing::Allocation allocation = {};
+    while (!m_ring.TryAllocate(size, STAGING_ALIGNMENT, &allocation))
+    {
+        if (m_inFlight.empty())
+            Submit();
+        if (m_inFlight.empty())
+            return false;
+        Retire(true);
+    }
+
+    m_reserved.insert(allocation.position);
+    m_reservedBytes += size;
+
+    write->mapped = allocation.mapped;
+    write->buffer = allocation.buffer;
+    write->offset = allocation.offset;
+    write->size = size;
+    write->position = allocation.position;
+    return true;
+}
+
+void UploadBatch::CommitImageWrite(const ImageWrite& write, VkImage image, uint32_t width, uint32_t height, uint32_t baseArrayLayer, uint32_t layerCount, uint32_t mipLevel)
+{
+    if (m_depth == 0)
+        throw std::runtime_error("Upload enqueued outside of Begin/End");
+
+    CancelImageWrite(write);
+    m_pendingBytes += write.size;
+
+    ImageCopy copy = {};
+    copy.srcBuffer = write.buffer;
+    copy.image = image;
+    copy.region.bufferOffset = write.offset;
+    copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.region.imageSubresource.mipLevel = mipLevel;
+    copy.region.imageSubresource.baseArrayLayer = baseArrayLayer;
+    copy.region.imageSubresource.layerCount = layerCount;
+    copy.region.imageOffset = { 0, 0, 0 };
+    copy.region.imageExtent = { width, height, 1 };
+    m_imageCopies.push_back(copy);
+
+    if (m_pendingBytes > UPLOAD_BATCH_SUBMIT_SIZE)
+        Submit();
+}
+
+void UploadBatch::CancelImageWrite(const ImageWrite& write)
+{
+    // The space itself comes back with the next submit that retires
+    auto found = m_reserved.find(write.position);
+    if (found == m_reserved.end())
+        return;
+    m_reserved.erase(found);
+    m_reservedBytes -= write.size;
+}
+
+void UploadBatch::EnqueueImageTransition(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount, uint32_t mipLevels, uint32_t baseArrayLayer)
+{
+    if (m_depth == 0)
+        throw std::runtime_error("Upload enqueued outside of Begin/End");
+
+    // Updating an image that already has barriers in this batch would transition it from the wrong layout,
+    // so what is queued for it goes first
+    if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && HasPendingBarrier(image))
+        Submit();
+
+    // Into TRANSFER_DST goes before the copies, out of it after them
+    if (newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+        m_preBarriers.push_back(MakeImageBarrier(image, oldLayout, newLayout, layerCount, 0, mipLevels, baseArrayLayer));
+    else
+        m_postBarriers.push_back(MakeImageBarrier(image, oldLayout, newLayout, layerCount, 0, mipLevels, baseArrayLayer));
+}
+
+void UploadBatch::EnqueueMipGeneration(VkImage image, uint32_t width, uint32_t height, uint32_t layerCount, uint32_t mipLevels, uint32_t baseArrayLayer, VkRect2D region)
+{
+    if (m_depth == 0)
+        throw std::runtime_error("Upload enqueued outside of Begin/End");
+
+    if (region.extent.width == 0 || region.extent.height == 0)
+        region = { { 0, 0 }, { width, height } };
+    m_mipGenerations.push_back({ image, width, height, baseArrayLayer, layerCount, mipLevels, region });
+}
+
+void UploadBatch::UseTransferQueue(VkQueue queue, VkCommandPool commandPool, uint32_t transferFamily, uint32_t graphicsFamily)
+{
+    if (HasWork() || !m_inFlight.empty())
+        throw std::runtime_error("Transfer queue set after uploads started");
+
+    m_transferQueue = queue;
+    m_transferCommandPool = commandPool;
+    m_transferFamily = transferFamily;
+    m_graphicsFamily = graphicsFamily;
+}
+
+void UploadBatch::UploadOnTransferQueue(VkImage image)
+{
+    if (m_transferQueue != VK_NULL_HANDLE)
+        m_transferImages.insert(image);
+}
+
+void UploadBatch::Submit()
+{
+    if (!HasWork())
+        return;
+
+    InFlight submit = {};
+    submit.ringPosition = m_reserved.empty() ? m_ring.GetHead() : std::min(m_ring.GetHead(), *m_reserved.begin());
+    submit.dedicated.swap(m_dedicated);
+
+    // Takes what belongs to the transfer queue out of the batch, the rest is recorded below as if there was none
+    if (!m_transferImages.empty())
+        SubmitTransfer(submit);
+
+    if (HasWork())
+    {
+        VkCommandBuffer commandBuffer = BeginCommandBuffer(m_device, m_commandPool);
+
+        RecordPreBarriers(commandBuffer, m_preBarriers);
+
+        for (const auto& copy : m_bufferCopies)
+            vkCmdCopyBuffer(commandBuffer, copy.srcBuffer, copy.dstBuffer, 1, &copy.region);
+
+        for (const auto& copy : m_imageCopies)
+            vkCmdCopyBufferToImage(commandBuffer, copy.srcBuffer, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+
+        // Vertex, index and indirect draw data has to be visible to the draws submitted after this batch
+        if (!m_bufferCopies.empty())
+        {
+            VkMemoryBarrier memoryBarrier = {};
+            memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            memoryBarrier.dstAccessMask = BUFFER_READ_ACCESS;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, BUFFER_READ_STAGES, 0,
+                1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        RecordMipGeneration(commandBuffer, m_mipGenerations, &m_postBarriers);
+
+        if (!m_postBarriers.empty())
+        {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                0, nullptr, 0, nullptr, static_cast<uint32_t>(m_postBarriers.size()), m_postBarriers.data());
+        }
+
+        vkEndCommandBuffer(commandBuffer);
+        submit.commandBuffer = commandBuffer;
+        submit.fence = AcquireFence();
+        QueueSubmit(m_queue, commandBuffer, submit.fence);
+    }
+
+    m_inFlight.push_back(std::move(submit));
+    m_submitCount++;
+
+    m_preBarriers.clear();
+    m_postBarriers.clear();
+    m_bufferCopies.clear();
+    m_imageCopies.clear();
+    m_mipGenerations.clear();
+    m_pendingBytes = 0;
+
+    // Cheap, only looks at fences that already signaled
+    Retire(false);
+}
+
+void UploadBatch::SubmitTransfer(InFlight& submit)
+{
+    auto onTransfer = [this](VkImage image) { return m_transferImages.count(image) != 0; };
+
+    std::vector<VkImageMemoryBarrier> preBarriers, releases;
+    std::vector<ImageCopy> copies;
+    auto isPre = std::stable_partition(m_preBarriers.begin(), m_preBarriers.end(), [&](const VkImageMemoryBarrier& barrier) { return !onTransfer(barrier.image); });
+    preBarriers.assign(isPre, m_preBarriers.end());
+    m_preBarriers.erase(isPre, m_preBarriers.end());
+    auto isCopy = std::stable_partition(m_imageCopies.begin(), m_imageCopies.end(), [&](const ImageCopy& copy) { return !onTransfer(copy.image); });
+    copies.assign(isCopy, m_imageCopies.end());
+    m_imageCopies.erase(isCopy, m_imageCopies.end());
+
+    // The closing transition becomes the release here and the acquire on the graphics queue, with the same layout change.
+    // Mips are blitted on the graphics queue after their acquire, the image stays TRANSFER_DST until then
+    auto isPost = std::stable_partition(m_postBarriers.begin(), m_postBarriers.end(), [&](const VkImageMemoryBarrier& barrier) { return !onTransfer(barrier.image); });
+    for (auto it = isPost; it != m_postBarriers.end(); ++it)
+        AddOwnershipTransfer(*it, &releases, &submit.acquires);
+    m_postBarriers.erase(isPost, m_postBarriers.end());
+    auto isMip = std::stable_partition(m_mipGenerations.begin(), m_mipGenerations.end(), [&](const MipGeneration& mip) { return !onTransfer(mip.image); });
+    for (auto it = isMip; it != m_mipGenerations.end(); ++it)
+    {
+        AddOwnershipTransfer(MakeImageBarrier(it->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, it->layerCount, 0, it->mipLevels, it->baseArrayLayer), &releases, &submit.acquires);
+        submit.acquires.back().dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        submit.acquireMips.push_back(*it);
+    }
+    m_mipGenerations.erase(isMip, m_mipGenerations.end());
+
+    if (preBarriers.empty() && copies.empty() && releases.empty())
+        return;
+
+    VkCommandBuffer commandBuffer = BeginCommandBuffer(m_device, m_transferCommandPool);
+
+    RecordPreBarriers(commandBuffer, preBarriers);
+
+    for (const auto& copy : copies)
+        vkCmdCopyBufferToImage(commandBuffer, copy.srcBuffer, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+
+    if (!releases.empty())
+    {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr, 0, nullptr, static_cast<uint32_t>(releases.size()), releases.data());
+    }
+
+    vkEndCommandBuffer(commandBuffer);
+    submit.transferCommandBuffer = commandBuffer;
+    submit.transferFence = AcquireFence();
+    QueueSubmit(m_transferQueue, commandBuffer, submit.transferFence);
+}
+
+void UploadBatch::SubmitAcquires(InFlight& submit)
+{
+    // The transfer fence has signaled, so the graphics queue has nothing to wait for and frames go on as before
+    VkCommandBuffer commandBuffer = BeginCommandBuffer(m_device, m_commandPool);
+
+    VkPipelineStageFlags acquireStages = 0;
+    for (const auto& acquire : submit.acquires)
+        acquireStages |= acquire.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, acquireStages, 0,
+        0, nullptr, 0, nullptr, static_cast<uint32_t>(submit.acquires.size()), submit.acquires.data());
+
+    if (!submit.acquireMips.empty())
+    {
+        std::vector<VkImageMemoryBarrier> postBarriers;
+        RecordMipGeneration(commandBuffer, submit.acquireMips, &postBarriers);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, static_cast<uint32_t>(postBarriers.size()), postBarriers.data());
+    }
+
+    vkEndCommandBuffer(commandBuffer);
+    submit.acquireCommandBuffer = commandBuffer;
+    submit.acquireFence = AcquireFence();
+    QueueSubmit(m_queue, commandBuffer, submit.acquireFence);
+
+    // Owned by the graphics family from now on, later updates are recorded there
+    for (const auto& acquire : submit.acquires)
+        m_transferImages.erase(acquire.image);
+    submit.acquires.clear();
+    submit.acquireMips.clear();
+}
+
+void UploadBatch::SubmitReadyAcquires()
+{
+    // Transfer submits finish in order, so stop at the first one still running
+    for (auto& submit : m_inFlight)
+    {
+        if (submit.acquires.empty())
+            continue;
+        if (vkGetFenceStatus(m_device, submit.transferFence) != VK_SUCCESS)
+            break;
+        SubmitAcquires(submit);
+    }
+}
+
+bool UploadBatch::IsDone(const InFlight& submit) const
+{
+    if (!submit.acquires.empty())
+        return false;
+    for (VkFence fence : { submit.fence, submit.transferFence, submit.acquireFence })
+    {
+        if (fence != VK_NULL_HANDLE && vkGetFenceStatus(m_device, fence) != VK_SUCCESS)
+            return false;
+    }
+    return true;
+}
+
+void UploadBatch::AddOwnershipTransfer(const VkImageMemoryBarrier& barrier, std::vector<VkImageMemoryBarrier>* releases, std::vector<VkImageMemoryBarrier>* acquires) const
+{
+    VkImageMemoryBarrier release = barrier;
+    release.srcQueueFamilyIndex = m_transferFamily;
+    release.dstQueueFamilyIndex = m_graphicsFamily;
+    release.dstAccessMask = 0;
+    releases->push_back(release);
+
+    VkImageMemoryBarrier acquire = release;
+    acquire.srcAccessMask = 0;
+    acquire.dstAccessMask = barrier.dstAccessMask;
+    acquires->push_back(acquire);
+}
+
+void UploadBatch::RecordPreBarriers(VkCommandBuffer commandBuffer, std::vector<VkImageMemoryBarrier>& barriers)
+{
+    // New images wait for nothing, images that were drawn from wait for the fragment shaders before them
+    auto sampled = std::stable_partition(barriers.begin(), barriers.end(), [](const VkImageMemoryBarrier& barrier)
+    {
+        return barrier.oldLayout != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    });
+    uint32_t newCount = static_cast<uint32_t>(sampled - barriers.begin());
+    if (newCount)
+    {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, newCount, barriers.data());
+    }
+    if (sampled != barriers.end())
+    {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()) - newCount, barriers.data() + newCount);
+    }
+}
+
+VkFence UploadBatch::AcquireFence()
+{
+    VkFence fence;
+    if (m_freeFences.empty())
+    {
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(m_device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create upload batch fence");
+    }
+    else
+    {
+        fence = m_freeFences.back();
+        m_freeFences.pop_back();
+    }
+    return fence;
+}
+
+void UploadBatch::Flush()
+{
+    Submit();
+    while (!m_inFlight.empty())
+        Retire(true);
+}
+
+bool UploadBatch::IsSubmitComplete(size_t submitNumber)
+{
+    Retire(false);
+    return m_submitCount - m_inFlight.size() >= submitNumber;
+}
+
+void UploadBatch::Retire(bool waitOldest)
+{
+    if (waitOldest && !m_inFlight.empty())
+    {
+        // The oldest acquire can only go out once its transfer is done
+        InFlight& oldest = m_inFlight.front();
+        if (!oldest.acquires.empty())
+            vkWaitForFences(m_device, 1, &oldest.transferFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        SubmitReadyAcquires();
+        for (VkFence fence : { oldest.fence, oldest.transferFence, oldest.acquireFence })
+        {
+            if (fence != VK_NULL_HANDLE)
+                vkWaitForFences(m_device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
+    }
+    else
+    {
+        SubmitReadyAcquires();
+    }
+
+    // Submits finish in order, so stop at the first one still running
+    while (!m_inFlight.empty() && IsDone(m_inFlight.front()))
+    {
+        InFlight& submit = m_inFlight.front();
+        FreeCommandBuffers(submit);
+        for (VkFence fence : { submit.fence, submit.transferFence, submit.acquireFence })
+        {
+            if (fence == VK_NULL_HANDLE)
+                continue;
+            vkResetFences(m_device, 1, &fence);
+            m_freeFences.push_back(fence);
+        }
+
+        for (auto& staging : submit.dedicated)
+        {
+            vkDestroyBuffer(m_device, staging.buffer, nullptr);
+            vkFreeMemory(m_device, staging.memory, nullptr);
+        }
+
+        m_ring.Release(submit.ringPosition);
+        m_inFlight.pop_front();
+    }
+}
+
+StagingRing::Allocation UploadBatch::AllocateStaging(VkDeviceSize size)
+{
+    if (m_depth == 0)
+        throw std::runtime_error("Upload enqueued outside of Begin/End");
+
+    // Let the GPU start on what we have while the rest is still being copied
+    if (m_pendingBytes + size > UPLOAD_BATCH_SUBMIT_SIZE)
+        Submit();
+
+    m_pendingBytes += size;
+
+    // Would block the ring for too long, rare enough that a driver allocation doesn't matter
+    if (size > m_ring.GetCapacity() / 2)
+        return AllocateDedicated(size);
+
+    // Back-pressure: wait for the oldest submit until its part of the ring comes free
+    StagingRing::Allocation allocation = {};
+    while (!m_ring.TryAllocate(size, STAGING_ALIGNMENT, &allocation))
+    {
+        // Space held by the batch being recorded is only freed after it is submitted
+        if (m_inFlight.empty())
+            Submit();
+        // Nothing to wait for, the rest is held by ImageWrite reservations
+        if (m_inFlight.empty())
+            return AllocateDedicated(size);
+        Retire(true);
+    }
+
+    return allocation;
+}
+
+StagingRing::Allocation UploadBatch::AllocateDedicated(VkDeviceSize size)
+{
+    DedicatedStaging staging = {};
+    CreateBuffer(m_physicalDevice, m_device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging.buffer, &staging.memory);
+    m_dedicated.push_back(staging);
+
+    void* mapped;
+    vkMapMemory(m_device, staging.memory, 0, size, 0, &mapped);
+
+    StagingRing::Allocation allocation = {};
+    allocation.buffer = staging.buffer;
+    allocation.offset = 0;
+    allocation.mapped = static_cast<uint8_t*>(mapped);
+    return allocation;
+}
+
+bool UploadBatch::HasWork() const
+{
+    return !m_preBarriers.empty() || !m_postBarriers.empty() || !m_bufferCopies.empty() || !m_imageCopies.empty() || !m_mipGenerations.empty();
+}
+
+bool UploadBatch::HasPendingBarrier(VkImage image) const
+{
+    auto matches = [image](const VkImageMemoryBarrier& barrier) { return barrier.image == image; };
+    return std::any_of(m_preBarriers.begin(), m_preBarriers.end(), matches) ||
+        std::any_of(m_postBarriers.begin(), m_postBarriers.end(), matches) ||
+        std::any_of(m_mipGenerations.begin(), m_mipGenerations.end(), [image](const MipGeneration& mip) { return mip.image == image; });
+}
+
+void UploadBatch::RecordMipGeneration(VkCommandBuffer commandBuffer, const std::vector<MipGeneration>& mips, std::vector<VkImageMemoryBarrier>* postBarriers)
+{
+    uint32_t maxLevels = 0;
+    for (const auto& mip : mips)
+        maxLevels = std::max(maxLevels, mip.mipLevels);
+
+    // Rectangle of the previous level that changed, starts as the region of level 0
+    std::vector<VkRect2D> changed;
+    for (const auto& mip : mips)
+        changed.push_back(mip.region);
+
+    // Level by level across all images, so every step is one barrier call followed by the blits
+    std::vector<VkImageMemoryBarrier> barriers;
+    for (uint32_t level = 1; level < maxLevels; level++)
+    {
+        barriers.clear();
+        for (const auto& mip : mips)
+        {
+            if (level < mip.mipLevels)
+                barriers.push_back(MakeImageBarrier(mip.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mip.layerCount, level - 1, 1, mip.baseArrayLayer));
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        for (size_t it = 0; it < mips.size(); it++)
+        {
+            const MipGeneration& mip = mips[it];
+            if (level >= mip.mipLevels)
+                continue;
+
+            // Where a level halves exactly, texels 2n and 2n + 1 make texel n, so only the parents of changed texels are blitted
+            // An odd size doesn't map texels to whole parents, that axis is blitted whole
+            uint32_t size[2] = { mip.width, mip.height };
+            int32_t changedStart[2] = { changed[it].offset.x, changed[it].offset.y };
+            int32_t changedEnd[2] = { changedStart[0] + static_cast<int32_t>(changed[it].extent.width), changedStart[1] + static_cast<int32_t>(changed[it].extent.height) };
+            int32_t srcStart[2], srcEnd[2], dstStart[2], dstEnd[2];
+            for (int axis = 0; axis < 2; axis++)
+            {
+                int32_t srcSize = static_cast<int32_t>(std::max(1u, size[axis] >> (level - 1)));
+                int32_t dstSize = static_cast<int32_t>(std::max(1u, size[axis] >> level));
+                if (srcSize == dstSize * 2)
+                {
+                    dstStart[axis] = changedStart[axis] / 2;
+                    dstEnd[axis] = (changedEnd[axis] + 1) / 2;
+                    srcStart[axis] = dstStart[axis] * 2;
+                    srcEnd[axis] = dstEnd[axis] * 2;
+                }
+                else
+                {
+                    dstStart[axis] = 0;
+                    dstEnd[axis] = dstSize;
+                    srcStart[axis] = 0;
+                    srcEnd[axis] = srcSize;
+                }
+            }
+
+            VkImageBlit blit = {};
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, mip.baseArrayLayer, mip.layerCount };
+            blit.srcOffsets[0] = { srcStart[0], srcStart[1], 0 };
+            blit.srcOffsets[1] = { srcEnd[0], srcEnd[1], 1 };
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, mip.baseArrayLayer, mip.layerCount };
+            blit.dstOffsets[0] = { dstStart[0], dstStart[1], 0 };
+            blit.dstOffsets[1] = { dstEnd[0], dstEnd[1], 1 };
+
+            vkCmdBlitImage(commandBuffer, mip.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mip.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+            changed[it] = { { dstStart[0], dstStart[1] }, { static_cast<uint32_t>(dstEnd[0] - dstStart[0]), static_cast<uint32_t>(dstEnd[1] - dstStart[1]) } };
+        }
+    }
+
+    // Every level but the last ended up as blit source, all of them become shader readable with the other post barriers
+    for (const auto& mip : mips)
+    {
+        if (mip.mipLevels > 1)
+            postBarriers->push_back(MakeImageBarrier(mip.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mip.layerCount, 0, mip.mipLevels - 1, mip.baseArrayLayer));
+        postBarriers->push_back(MakeImageBarrier(mip.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mip.layerCount, mip.mipLevels - 1, 1, mip.baseArrayLayer));
+    }
+}
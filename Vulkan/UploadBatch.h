@@ -0,0 +1,207 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <set>
+#include <unordered_set>
+#include <vector>
+#include "StagingRing.h"
+
+// Collects buffer and image uploads and submits them as one command buffer with a fence
+// Usage: Begin(), Enqueue...() as many times as needed, End()
+// Begin/End nest, the outermost End submits (without waiting, later draws on the same queue are ordered after it)
+// Image barriers are grouped: every transition to TRANSFER_DST is recorded before all copies
+// and every transition out of it after all copies, so N images cost two barrier calls
+// Staging comes from a StagingRing, when it is full we wait for the oldest submit instead of allocating more
+// With a transfer queue, images marked with UploadOnTransferQueue are copied there and released to the graphics family.
+// Nothing on the graphics queue waits for that: once the transfer fence has signaled, the acquire (and the mip blits)
+// go out in their own graphics submit. Buffers and other images stay on the graphics queue, their users draw them right away
+class UploadBatch
+{
+public:
+	UploadBatch(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, VkCommandPool commandPool);
+	~UploadBatch();
+
+	UploadBatch(const UploadBatch&) = delete;
+	UploadBatch& operator=(const UploadBatch&) = delete;
+
+	// Before the first upload, families must differ. Buffers and images stay VK_SHARING_MODE_EXCLUSIVE
+	void UseTransferQueue(VkQueue queue, VkCommandPool commandPool, uint32_t transferFamily, uint32_t graphicsFamily);
+	// For a new image that is only drawn once IsSubmitComplete says its upload is done (async and streamed textures)
+	// Its copies until the closing transition (or mip generation) go to the transfer queue, no-op without one
+	void UploadOnTransferQueue(VkImage image);
+	// Drops a destroyed image that never got its closing transition, a reused handle would go to the transfer queue
+	void ForgetImage(VkImage image) { m_transferImages.erase(image); }
+
+	void Begin();
+	void End();
+
+	// Data is copied into staging memory immediately, the caller can free it right after
+	void EnqueueBufferCopy(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+	void EnqueueImageCopy(const void* data, VkDeviceSize size, VkImage image, uint32_t width, uint32_t height, uint32_t baseArrayLayer = 0, uint32_t layerCount = 1, uint32_t mipLevel = 0);
+	// Rectangle of an RGBA8 image, data rows are rowPitch bytes apart and only width * height * 4 bytes are staged
+	void EnqueueImageRegionCopy(const void* data, size_t rowPitch, VkImage image, int32_t x, int32_t y, uint32_t width, uint32_t height, uint32_t arrayLayer = 0, uint32_t mipLevel = 0);
+	// SHADER_READ_ONLY -> TRANSFER_DST makes the copies wait (on the GPU) for earlier draws sampling the image,
+	// images coming from UNDEFINED don't wait for anything
+	void EnqueueImageTransition(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount = 1, uint32_t mipLevels = 1, uint32_t baseArrayLayer = 0);
+	// Blits level 0 down the whole chain after the copies, image must be in TRANSFER_DST and ends up SHADER_READ_ONLY
+	// (replaces the closing transition), needs a format with linear blit support
+	// With a region (of level 0) only the texels it feeds are blitted again on every level, the rest keep their contents
+	void EnqueueMipGeneration(VkImage image, uint32_t width, uint32_t height, uint32_t layerCount, uint32_t mipLevels, uint32_t baseArrayLayer = 0, VkRect2D region = {});
+
+	// Staging handed out before its contents exist, so decoders (on any thread) write straight into mapped memory
+	// The space stays allocated across submits until CommitImageWrite records the copy or CancelImageWrite drops it
+	struct ImageWrite
+	{
+		uint8_t* mapped = nullptr;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint64_t position = 0;
+	};
+	// False when the ring can't take it now (reservations already hold half of it, nothing left to wait for...),
+	// the caller falls back to EnqueueImageCopy. Reserve/Commit/Cancel are called from the owning thread only
+	bool ReserveImageWrite(VkDeviceSize size, ImageWrite* write);
+	void CommitImageWrite(const ImageWrite& write, VkImage image, uint32_t width, uint32_t height, uint32_t baseArrayLayer = 0, uint32_t layerCount = 1, uint32_t mipLevel = 0);
+	void CancelImageWrite(const ImageWrite& write);
+
+	// Submit whatever is queued, done automatically by End and when enough staging is waiting
+	void Submit();
+	// Submit and wait until the GPU has finished every upload
+	void Flush();
+
+	size_t GetSubmitCount() const { return m_submitCount; }
+	// Number of the submit that carries everything enqueued so far, the next one while work is still waiting
+	size_t GetEnqueuedSubmit() const { return m_submitCount + (HasWork() ? 1 : 0); }
+	// Polls the fences without waiting, true once submits up to submitNumber have finished on the GPU (acquires included)
+	// Acquires of transfers that finished go out from here, callers waiting for a texture poll this every frame
+	bool IsSubmitComplete(size_t submitNumber);
+	const StagingRing& GetStagingRing() const { return m_ring; }
+
+private:
+	// Uploads too big for the ring get their own buffer, freed with the submit that used it
+	struct DedicatedStaging
+	{
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+	};
+
+
+	struct BufferCopy
+	{
+		VkBuffer srcBuffer;
+		VkBuffer dstBuffer;
+		VkBufferCopy region;
+	};
+
+	struct ImageCopy
+	{
+		VkBuffer srcBuffer;
+		VkImage image;
+		VkBufferImageCopy region;
+	};
+
+	struct MipGeneration
+	{
+		VkImage image;
+		uint32_t width;
+		uint32_t height;
+		uint32_t baseArrayLayer;
+		uint32_t layerCount;
+		uint32_t mipLevels;
+		VkRect2D region; // of level 0, the whole level when the extent is 0
+	};
+
+	// Every handle is VK_NULL_HANDLE when the batch had no work of that kind, the submit is done once all fences signaled
+	struct InFlight
+	{
+		VkFence fence;                         // graphics queue
+		VkCommandBuffer commandBuffer;
+		VkFence transferFence;
+		VkCommandBuffer transferCommandBuffer;
+		VkFence acquireFence;                  // graphics queue, submitted after the transfer fence signaled
+		VkCommandBuffer acquireCommandBuffer;
+		std::vector<VkImageMemoryBarrier> acquires;  // waiting for the transfer fence, empty once submitted
+		std::vector<MipGeneration> acquireMips;      // blitted after their acquire
+		uint64_t ringPosition; // ring space up to here is free once the fences signal
+		std::vector<DedicatedStaging> dedicated;
+	};
+
+	VkPhysicalDevice m_physicalDevice;
+	VkDevice m_device;
+	VkQueue m_queue;
+	VkCommandPool m_commandPool;
+	VkQueue m_transferQueue = VK_NULL_HANDLE;
+	VkCommandPool m_transferCommandPool = VK_NULL_HANDLE;
+	uint32_t m_transferFamily = VK_QUEUE_FAMILY_IGNORED;
+	uint32_t m_graphicsFamily = VK_QUEUE_FAMILY_IGNORED;
+	StagingRing m_ring;
+
+	int m_depth = 0;
+	size_t m_submitCount = 0;
+	VkDeviceSize m_pendingBytes = 0;
+
+	std::deque<InFlight> m_inFlight;
+	std::multiset<uint64_t> m_reserved; // ring positions of uncommitted ImageWrites, submits never release past the first
+	VkDeviceSize m_reservedBytes = 0;
+	// Marked with UploadOnTransferQueue and not released to the graphics family yet
+	// Kept across submits, an automatic submit can split a barrier from its copies
+	std::unordered_set<VkImage> m_transferImages;
+	std::vector<VkFence> m_freeFences;
+	std::vector<DedicatedStaging> m_dedicated;
+
+	std::vector<VkImageMemoryBarrier> m_preBarriers;
+	std::vector<VkImageMemoryBarrier> m_postBarriers;
+	std::vector<BufferCopy> m_bufferCopies;
+	std::vector<ImageCopy> m_imageCopies;
+	std::vector<MipGeneration> m_mipGenerations;
+
+	StagingRing::Allocation AllocateStaging(VkDeviceSize size);
+	StagingRing::Allocation AllocateDedicated(VkDeviceSize size);
+	void Retire(bool waitOldest);
+	bool HasWork() const;
+	bool HasPendingBarrier(VkImage image) const;
+	void SubmitTransfer(InFlight& submit);
+	void SubmitAcquires(InFlight& submit);
+	void SubmitReadyAcquires();
+	bool IsDone(const InFlight& submit) const;
+	void AddOwnershipTransfer(const VkImageMemoryBarrier& barrier, std::vector<VkImageMemoryBarrier>* releases, std::vector<VkImageMemoryBarrier>* acquires) const;
+	void RecordPreBarriers(VkCommandBuffer commandBuffer, std::vector<VkImageMemoryBarrier>& barriers);
+	VkFence AcquireFence();
+	void FreeCommandBuffers(const InFlight& submit);
+	void RecordMipGeneration(VkCommandBuffer commandBuffer, const std::vector<MipGeneration>& mips, std::vector<VkImageMemoryBarrier>* postBarriers);
+};
+
+// Begin on construction, End when the scope is left, by an exception too, so the depth can't stay raised
+// (every later End would then never submit). A failing submit while unwinding is dropped for the exception in flight
+class UploadScope
+{
+public:
+	explicit UploadScope(UploadBatch& batch) : m_batch(batch), m_exceptions(std::uncaught_exceptions()) { m_batch.Begin(); }
+	~UploadScope() noexcept(false)
+	{
+		if (std::uncaught_exceptions() == m_exceptions)
+		{
+			m_batch.End();
+			return;
+		}
+		try
+		{
+			m_batch.End();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	UploadScope(const UploadScope&) = delete;
+	UploadScope& operator=(const UploadScope&) = delete;
+
+private:
+	UploadBatch& m_batch;
+	int m_exceptions;
+};
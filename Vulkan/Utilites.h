@@ -6,6 +6,9 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+// Decoding settings (threads, texture cache, FastPng, pixel conversions, dedupe) live there, LoadBench builds without glm and GLFW
+#include "LoaderSettings.h"
+
 const int MAX_FRAME_DRAWS = 2;
 
 const size_t MAX_OBJECTS = 2;
@@ -14,10 +17,67 @@ const size_t ADD_RANDOM_MASHES = 1;
 
 const bool PRINT_OBJECTS = false;
 
-//experimental
-const bool USE_THREAD_LOADING = false;
+// Draw meshes through the SpriteBatcher: vertices moved on the CPU into one stream per frame, one draw per texture change
+const bool USE_SPRITE_BATCHING = true;
+
+// Draw meshes as instances of one shared quad (shader_instanced.vert), one draw per texture change, overrides USE_SPRITE_BATCHING
+const bool USE_INSTANCED_SPRITES = true;
+
+// Instanced sprites draw from device local instance/command buffers with vkCmdDrawIndexedIndirect(Count),
+// needs drawIndirectFirstInstance (falls back to direct draws without it)
+const bool USE_INDIRECT_DRAWS = true;
+
+// All textures in one partially bound sampler array indexed in the shader, when the device has Vulkan 1.2 descriptor indexing
+// A texture change then neither breaks an instanced run nor binds a descriptor set
+const bool USE_BINDLESS_TEXTURES = true;
+
+// Upper limit of textures in the bindless array (device update after bind limits still apply)
+const uint32_t BINDLESS_MAX_TEXTURES = 16384;
+
+// Record the render pass into secondary command buffers, meshes drawn one by one are split over worker threads
+const bool USE_THREADED_RECORDING = true;
+
+// Number of recording workers, 0 = one per hardware thread
+const size_t RECORDING_THREADS = 0;
+
+// Keep the scene secondaries of each swapchain image until a mesh or texture changes, only ImGui is recorded every frame
+// (needs USE_THREADED_RECORDING)
+const bool USE_RETAINED_SCENE = true;
+
+// Load <animation dir>.pack (made by TexturePacker) instead of decoding the PNGs when it exists
+const bool USE_TEXTURE_PACKS = true;
+
+// Put same sized animation frames into 2D array textures, one image and descriptor per array instead of per frame
+const bool USE_TEXTURE_ARRAYS = true;
+
+// Upper limit of layers per array (device maxImageArrayLayers still applies)
+const uint32_t TEXTURE_ARRAY_MAX_LAYERS = 512;
+
+// Persistently mapped staging ring all uploads go through, uploads bigger than half of it get their own buffer
+const VkDeviceSize STAGING_RING_SIZE = 128 * 1024 * 1024;
+
+// Upload batch is submitted early when this much staging is waiting, so the GPU copies while the CPU keeps filling the ring
+const VkDeviceSize UPLOAD_BATCH_SUBMIT_SIZE = 32 * 1024 * 1024;
 
-const size_t NUMBER_OF_THREADS = 8;
+// Async and streamed in textures upload through a transfer only queue family (DMA engine) when the device has one, so they overlap with drawing
+const bool USE_TRANSFER_QUEUE = true;
+
+// Device memory is taken from the driver in blocks of this size and sub-allocated
+const VkDeviceSize DEVICE_ALLOCATOR_BLOCK_SIZE = 64 * 1024 * 1024;
+
+// Resources this big or bigger (texture arrays mostly) get their own vkAllocateMemory
+const VkDeviceSize DEVICE_ALLOCATOR_DEDICATED_SIZE = 16 * 1024 * 1024;
+
+// Buffers up to this size are rounded to power of two size classes and their slots recycled
+const VkDeviceSize DEVICE_ALLOCATOR_SMALL_SIZE = 64 * 1024;
+
+// Full mip chain for every texture, blitted on the GPU or box filtered on the CPU when the format can't be blitted
+const bool GENERATE_MIPMAPS = true;
+
+// Textures past this much VRAM are evicted least recently drawn first and streamed back from their file/pack when drawn again
+// Evicted textures draw with the placeholder (Textures\1px.png) until they are back
+const bool USE_TEXTURE_RESIDENCY = true;
+const VkDeviceSize TEXTURE_MEMORY_BUDGET = 1536ull * 1024 * 1024;
 
 static std::vector<uint32_t> MESH_INDICES =
 {
@@ -35,6 +95,7 @@ struct QueueFamilyIndices
 {
 	int graphicsFamily = -1; // locations of graphics queue family
 	int presentationFamily = -1; // location of presentation queue family
+	int transferFamily = -1; // transfer only family, -1 when uploads go through the graphics queue
 	// check if queue families are valid
 	bool isValid()
 	{
@@ -93,6 +154,7 @@ struct Vertex
 	glm::vec3 m_color;
 	glm::vec2 m_tex; // texture coords
 	float hasTexture;
+	float m_textureLayer = 0.0f; // added to the pushed layer, set by the sprite batcher
 };
 
 
@@ -151,23 +213,6 @@ static void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDev
 	vkBindBufferMemory(device, *buffer, *bufferMemory, 0);
 }
 
-static void EndAndSubmitCommandBuffer(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer commandBuffer)
-{
-	vkEndCommandBuffer(commandBuffer);
-
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	// Submit transfer command to transfre queue and wait until it finishes
-	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(queue);
-
-	// Free temporary command buffer back to pool
-	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
 static VkCommandBuffer BeginCommandBuffer(VkDevice device, VkCommandPool commandPool)
 {
 	// Command buffer to hold transfer commands
@@ -192,96 +237,3 @@ static VkCommandBuffer BeginCommandBuffer(VkDevice device, VkCommandPool command
 
 	return commandBuffer;
 }
-
-static void CopyBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize)
-{
-
-	auto transferCommandBuffer = BeginCommandBuffer(device, transferCommandPool);
-
-	// Region of data to copy from and to
-	VkBufferCopy bufferCopyRegion = {};
-	bufferCopyRegion.srcOffset = 0;
-	bufferCopyRegion.dstOffset = 0;
-	bufferCopyRegion.size = bufferSize;
-
-	// Command to copy src buffer to dst buffer
-	vkCmdCopyBuffer(transferCommandBuffer, srcBuffer, dstBuffer, 1, &bufferCopyRegion);
-
-	EndAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
-}
-
-
-
-
-
-static void CopyImageBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool, VkBuffer srcBuffer, VkImage image, uint32_t width, uint32_t height)
-{
-	VkCommandBuffer transferCommandBuffer = BeginCommandBuffer(device, transferCommandPool);
-
-	VkBufferImageCopy imageRegion = {};
-	imageRegion.bufferOffset = 0; // Offset into data
-	imageRegion.bufferRowLength = 0; // Row length of data to calculate data spacing
-	imageRegion.bufferImageHeight = 0; // Image height to calculate data spacing
-	imageRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; // which aspect of image to copy
-	imageRegion.imageSubresource.mipLevel = 0;
-	imageRegion.imageSubresource.baseArrayLayer = 0;
-	imageRegion.imageSubresource.layerCount = 1;
-	imageRegion.imageOffset = { 0,0,0 };
-	imageRegion.imageExtent = { width, height, 1 };
-
-	// Copy buffer to given image
-	vkCmdCopyBufferToImage(transferCommandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageRegion);
-
-	EndAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
-}
-
-
-static void TransitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
-{
-	VkCommandBuffer commandBuffer = BeginCommandBuffer(device, commandPool);
-
-	VkImageMemoryBarrier imageMemoryBarrier = {};
-	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	imageMemoryBarrier.oldLayout = oldLayout;
-	imageMemoryBarrier.newLayout = newLayout;
-	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	imageMemoryBarrier.image = image;
-	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-	imageMemoryBarrier.subresourceRange.levelCount = 1;
-	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-	imageMemoryBarrier.subresourceRange.layerCount = 1;
-
-	VkPipelineStageFlags srcStage = 0;
-	VkPipelineStageFlags dstStage = 0;
-
-
-
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-	{
-		imageMemoryBarrier.srcAccessMask = 0;
-		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-	{
-		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	}
-
-	vkCmdPipelineBarrier(
-		commandBuffer,
-		srcStage, dstStage,
-		0,
-		0, nullptr,
-		0, nullptr,
-		1, &imageMemoryBarrier
-	);
-
-	EndAndSubmitCommandBuffer(device, commandPool, queue, commandBuffer);
-}
\ No newline at end of file
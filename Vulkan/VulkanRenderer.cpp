@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
+#include "ScratchArena.h"
 
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -127,6 +129,8 @@ void VulkanRenderer::CreateLogicalDevice()
     // for queue creation information, and set for family indices
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<int> queueFamilyIndices{ indices.graphicsFamily, indices.presentationFamily };
+    if (indices.transferFamily >= 0)
+        queueFamilyIndices.insert(indices.transferFamily);
 
     // Queues the logical device needs to create and info to do so
     for (int queueFamilyIndex : queueFamilyIndices)
@@ -147,10 +151,65 @@ void VulkanRenderer::CreateLogicalDevice()
     deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
     deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(mainDevice.physicalDevice, &supportedFeatures);
+    textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+    // Indirect runs start at their first instance
+    indirectDraws = USE_INDIRECT_DRAWS && supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+
     VkPhysicalDeviceFeatures physicalFeatures = {};
     physicalFeatures.samplerAnisotropy = VK_TRUE;
+    physicalFeatures.textureCompressionBC = textureCompressionBC ? VK_TRUE : VK_FALSE; // optional, BC textures fall back to RGBA8
+    physicalFeatures.drawIndirectFirstInstance = indirectDraws ? VK_TRUE : VK_FALSE;
     deviceCreateInfo.pEnabledFeatures = &physicalFeatures; // shaders, geometry...
 
+    // Bindless textures need Vulkan 1.2 descriptor indexing, without it every texture keeps its own set
+    // The indirect draw count is Vulkan 1.2 as well, without it the CPU passes the number of draws
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
+    if ((USE_BINDLESS_TEXTURES || indirectDraws) && deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+    {
+        VkPhysicalDeviceVulkan12Features supported12 = {};
+        supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 supported = {};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported.pNext = &supported12;
+        vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &supported);
+
+        indirectDrawCount = indirectDraws && supported12.drawIndirectCount;
+        bindlessTextures = USE_BINDLESS_TEXTURES && supported12.runtimeDescriptorArray && supported12.shaderSampledImageArrayNonUniformIndexing && supported12.descriptorBindingPartiallyBound
+            && supported12.descriptorBindingSampledImageUpdateAfterBind && supported12.descriptorBindingUpdateUnusedWhilePending;
+    }
+
+    VkPhysicalDeviceVulkan12Features enabled12 = {};
+    enabled12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if (indirectDrawCount)
+    {
+        enabled12.drawIndirectCount = VK_TRUE;
+        deviceCreateInfo.pNext = &enabled12;
+    }
+    if (bindlessTextures)
+    {
+        enabled12.runtimeDescriptorArray = VK_TRUE;                       // unsized sampler array in the shader
+        enabled12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;    // index differs between instances of one draw
+        enabled12.descriptorBindingPartiallyBound = VK_TRUE;              // slots without a texture are fine as long as nothing samples them
+        enabled12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE; // new textures are written while the set is bound
+        enabled12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;    // ... and while frames using other slots are in flight
+        deviceCreateInfo.pNext = &enabled12;
+
+        VkPhysicalDeviceVulkan12Properties properties12 = {};
+        properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties = {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &properties12;
+        vkGetPhysicalDeviceProperties2(mainDevice.physicalDevice, &properties);
+
+        // A combined image sampler counts as a sampler and a sampled image
+        bindlessTextureCapacity = std::min({ BINDLESS_MAX_TEXTURES,
+            properties12.maxPerStageDescriptorUpdateAfterBindSampledImages, properties12.maxPerStageDescriptorUpdateAfterBindSamplers,
+            properties12.maxDescriptorSetUpdateAfterBindSampledImages, properties12.maxDescriptorSetUpdateAfterBindSamplers });
+    }
+
     VkResult vkResult = vkCreateDevice(mainDevice.physicalDevice, &deviceCreateInfo, nullptr, &mainDevice.logicalDevice);
     if (vkResult != VK_SUCCESS)
     {
@@ -161,6 +220,8 @@ void VulkanRenderer::CreateLogicalDevice()
     // so we want hangle to queues
     vkGetDeviceQueue(mainDevice.logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
     vkGetDeviceQueue(mainDevice.logicalDevice, indices.presentationFamily, 0, &presentationQueue);
+    if (indices.transferFamily >= 0)
+        vkGetDeviceQueue(mainDevice.logicalDevice, indices.transferFamily, 0, &transferQueue);
 }
 
 void VulkanRenderer::SetupDebugMessenger()
@@ -338,6 +399,13 @@ void VulkanRenderer::CreateCommandPool()
         throw std::runtime_error("Failed to create command pool");
     }
 
+    // Upload command buffers for the transfer queue, recorded and freed by the upload batch
+    if (indices.transferFamily >= 0)
+    {
+        poolInfo.queueFamilyIndex = indices.transferFamily;
+        if (vkCreateCommandPool(mainDevice.logicalDevice, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create transfer command pool");
+    }
 }
 
 void VulkanRenderer::CreateCommandBuffers()
@@ -366,6 +434,12 @@ void VulkanRenderer::Draw()
     vkWaitForFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
     vkResetFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame]);
 
+    // The fence just waited on belongs to the frame MAX_FRAME_DRAWS back, so everything up to it is done
+    if (frameNumber + 1 >= MAX_FRAME_DRAWS)
+        completedFrames = frameNumber + 1 - MAX_FRAME_DRAWS;
+    UpdateAsyncTextures();
+    UpdateTextureResidency();
+
     // -- Get Next image --
     // Get index of next image to be drawn to, and signal semaphore when ready to be drawn to
     // If function returns VK_ERROR_OUT_OF_DATE_KRH we need to recreate swapchain
@@ -384,7 +458,15 @@ void VulkanRenderer::Draw()
         break;
     }
 
+    // The image's last frame may have gone through another frame slot, its command buffers and streams are rewritten now
+    // (the fence of this slot was waited on above and is already reset)
+    if (imageFences[imageIndex] != VK_NULL_HANDLE && imageFences[imageIndex] != drawFences[currentFrame])
+        vkWaitForFences(mainDevice.logicalDevice, 1, &imageFences[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    imageFences[imageIndex] = drawFences[currentFrame];
+
+    auto recordStart = std::chrono::steady_clock::now();
     RecordCommands(imageIndex);
+    recordMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
 
     UpdateUniformBuffer(imageIndex);
 
@@ -426,6 +508,7 @@ void VulkanRenderer::Draw()
     }
 
     currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+    frameNumber++;
 }
 
 
@@ -677,6 +760,8 @@ void VulkanRenderer::CleanUp()
 {
     // Wait untill no action is run on device
     vkDeviceWaitIdle(mainDevice.logicalDevice);
+    textureResidency.reset();
+    asyncTextureLoader.reset();
 
     ImGui_ImplVulkan_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -686,20 +771,30 @@ void VulkanRenderer::CleanUp()
 
     vkDestroyDescriptorPool(mainDevice.logicalDevice, samplerDescriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, samplerSetLayout, nullptr);
+    if (bindlessTextures)
+    {
+        vkDestroyDescriptorPool(mainDevice.logicalDevice, bindlessDescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, bindlessSetLayout, nullptr);
+    }
 
     vkDestroySampler(mainDevice.logicalDevice, sampler, nullptr);
 
-    for (size_t i = 0; i < textureImages.size(); i++)
+    for (auto& texture : textures)
     {
-        vkDestroyImageView(mainDevice.logicalDevice, textureImageViews[i], nullptr);
-        vkDestroyImage(mainDevice.logicalDevice, textureImages[i], nullptr);
-        vkFreeMemory(mainDevice.logicalDevice, textureImageMemory[i], nullptr);
+        vkDestroyImageView(mainDevice.logicalDevice, texture.view, nullptr);
+        deviceAllocator->DestroyImage(texture.image, texture.memory);
     }
-
+    textures.clear();
+    textureRegistry.Clear();
+    for (auto& retired : retiredTextures)
+    {
+        vkDestroyImageView(mainDevice.logicalDevice, retired.view, nullptr);
+        deviceAllocator->DestroyImage(retired.image, retired.memory);
+    }
+    retiredTextures.clear();
 
     vkDestroyImageView(mainDevice.logicalDevice, depthBufferImageView, nullptr);
-    vkDestroyImage(mainDevice.logicalDevice, depthBufferImage, nullptr);
-    vkFreeMemory(mainDevice.logicalDevice, depthBufferImageMemory, nullptr);
+    deviceAllocator->DestroyImage(depthBufferImage, depthBufferImageMemory);
 
     vkDestroyDescriptorPool(mainDevice.logicalDevice, descriptorPool, nullptr);
 
@@ -719,13 +814,21 @@ void VulkanRenderer::CleanUp()
         vkDestroySemaphore(mainDevice.logicalDevice, imageAvailable[i], nullptr);
         vkDestroyFence(mainDevice.logicalDevice, drawFences[i], nullptr);
     }
+    secondaryRecorder.reset();
+    spriteInstancer.reset();
+    spriteBatcher.reset();
+    textureUploader.reset();
+    uploadBatch.reset();
     vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, nullptr);
+    if (transferCommandPool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(mainDevice.logicalDevice, transferCommandPool, nullptr);
 
     for (auto framebuffer : swapChainFrameBuffers)
     {
         vkDestroyFramebuffer(mainDevice.logicalDevice, framebuffer, nullptr);
     }
 
+    vkDestroyPipeline(mainDevice.logicalDevice, instancedPipeline, nullptr);
     vkDestroyPipeline(mainDevice.logicalDevice, graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, nullptr);
     vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, nullptr);
@@ -737,6 +840,8 @@ void VulkanRenderer::CleanUp()
     vkDestroySurfaceKHR(instance, surface, nullptr);
     if (enableValidationLayers)
         DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+    // Frees every block, including buffers of meshes still alive
+    deviceAllocator.reset();
     vkDestroyDevice(mainDevice.logicalDevice, nullptr);
     vkDestroyInstance(instance, nullptr);
 }
@@ -782,6 +887,20 @@ QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
         i++;
     }
 
+    // Transfer without graphics or compute is the DMA engine, it copies while the graphics queue draws
+    if (USE_TRANSFER_QUEUE)
+    {
+        for (uint32_t family = 0; family < queueFamilyCount; family++)
+        {
+            VkQueueFlags flags = queueFamilyList[family].queueFlags;
+            if (queueFamilyList[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            {
+                indices.transferFamily = static_cast<int>(family);
+                break;
+            }
+        }
+    }
+
     return indices;
 }
 
@@ -860,66 +979,264 @@ void VulkanRenderer::RecordCommands(uint32_t currentImage)
         throw std::runtime_error("Failed to start recording command buffer!");
     }
 
-    // Begin render pass
-    vkCmdBeginRenderPass(commandBuffers[currentImage], &renderpassBeginInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_INLINE);
+    if (secondaryRecorder)
+    {
+        // The render pass only executes what was recorded into secondaries
+        vkCmdBeginRenderPass(commandBuffers[currentImage], &renderpassBeginInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        RecordSecondaries(currentImage);
+        for (uint32_t set : { MAX_FRAME_DRAWS + currentImage, static_cast<uint32_t>(currentFrame) })
+        {
+            const auto& secondaries = secondaryRecorder->GetCommandBuffers(set);
+            if (!secondaries.empty())
+                vkCmdExecuteCommands(commandBuffers[currentImage], static_cast<uint32_t>(secondaries.size()), secondaries.data());
+        }
+    }
+    else
+    {
+        // Begin render pass
+        vkCmdBeginRenderPass(commandBuffers[currentImage], &renderpassBeginInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_INLINE);
+        RecordScene(commandBuffers[currentImage], currentImage);
+
+        ImDrawData* draw_data = ImGui::GetDrawData();
+        ImGui_ImplVulkan_RenderDrawData(draw_data, commandBuffers[currentImage]);
+    }
+
+    // End render pass
+    vkCmdEndRenderPass(commandBuffers[currentImage]);
+
+    result = vkEndCommandBuffer(commandBuffers[currentImage]);
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to stop recording a command buffer");
+    }
+}
+
+void VulkanRenderer::RecordScene(VkCommandBuffer commandBuffer, uint32_t currentImage)
+{
+    if (USE_INSTANCED_SPRITES)
+        RecordInstancedSprites(commandBuffer, currentImage);
+    else if (USE_SPRITE_BATCHING)
+        RecordSpriteBatches(commandBuffer, currentImage);
+    else
+        RecordMeshes(commandBuffer, currentImage);
+}
 
-    // Bind pipeline to be used in render pass
-    vkCmdBindPipeline(commandBuffers[currentImage], VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+void VulkanRenderer::RecordSecondaries(uint32_t currentImage)
+{
+    // The scene of each image is kept in its own set, recorded again only once the scene changed since
+    uint64_t sceneVersion = Engine::m_sceneVersion;
+    if (!USE_RETAINED_SCENE || retainedSceneVersions[currentImage] != sceneVersion)
+    {
+        secondaryRecorder->Begin(MAX_FRAME_DRAWS + currentImage, renderPass, swapChainFrameBuffers[currentImage]);
+        sceneTextures.clear();
 
+        // Only a draw per mesh makes enough commands to be worth splitting, the batched paths are a handful of draws
+        if (!USE_INSTANCED_SPRITES && !USE_SPRITE_BATCHING)
+        {
+            CollectMeshDraws();
+            secondaryRecorder->RecordParallel(meshDraws.size(), [this, currentImage](VkCommandBuffer commandBuffer, size_t first, size_t last)
+                {
+                    RecordMeshRange(commandBuffer, currentImage, first, last);
+                });
+            meshDraws.clear();
+        }
+        else
+        {
+            secondaryRecorder->Record([this, currentImage](VkCommandBuffer commandBuffer) { RecordScene(commandBuffer, currentImage); });
+        }
+        retainedSceneVersions[currentImage] = sceneVersion;
+    }
+    else if (textureResidency)
+    {
+        // Nothing is resolved while the scene is reused, its textures must still count as in use or they get evicted
+        for (int texId : sceneTextures)
+            textureResidency->Touch(texId, frameNumber);
+    }
+
+    // ImGui changes every frame and goes last, over the scene
+    secondaryRecorder->Begin(currentFrame, renderPass, swapChainFrameBuffers[currentImage]);
+    secondaryRecorder->Record([](VkCommandBuffer commandBuffer) { ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer); });
+}
+
+void VulkanRenderer::RecordMeshes(VkCommandBuffer commandBuffer, uint32_t currentImage)
+{
+    CollectMeshDraws();
+    RecordMeshRange(commandBuffer, currentImage, 0, meshDraws.size());
+    meshDraws.clear();
+}
+
+void VulkanRenderer::CollectMeshDraws()
+{
+    // Textures are resolved here, residency isn't thread safe and the recording threads only read meshDraws
+    meshDraws.clear();
     for (auto&& visual : Engine::m_meshes)
     {
         auto visualShared = visual.second.lock();
         if (!visualShared)
             continue;
 
-        VkBuffer vertexBuffers[] = { visualShared->GetVertexBuffer() }; // buffers to bind
+        int texId = ResolveTexture(visualShared->GetTexId(), frameNumber);
+        meshDraws.push_back({ std::move(visualShared), texId });
+    }
+}
+
+void VulkanRenderer::RecordMeshRange(VkCommandBuffer commandBuffer, uint32_t currentImage, size_t first, size_t last)
+{
+    // Bind pipeline to be used in render pass, a secondary starts with nothing bound
+    vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+    if (bindlessTextures)
+        BindTextureDescriptors(commandBuffer, currentImage, -1);
+
+    for (size_t i = first; i < last; i++)
+    {
+        Mesh& mesh = *meshDraws[i].mesh;
+        int texId = meshDraws[i].texId;
+
+        VkBuffer vertexBuffers[] = { mesh.GetVertexBuffer() }; // buffers to bind
         VkDeviceSize offsets[] = { 0 };  // offsets into buffers being bound
-        vkCmdBindVertexBuffers(commandBuffers[currentImage], 0, 1, vertexBuffers, offsets); // command to bind vertex buffer before drawing to them
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets); // command to bind vertex buffer before drawing to them
 
         // Bind mesh index buffer with 0 offset and using the uin32 type
-        vkCmdBindIndexBuffer(commandBuffers[currentImage], visualShared->GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(commandBuffer, mesh.GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
-        // Dynamic offset ammount 
-        //uint32_t dynamicOffset = static_cast<uint32_t>(modelUniformAlignment) * j;
+        Model model = mesh.GetModel();
+        model.m_textureIndex = std::max(texId, 0);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Model), &model);
 
-        vkCmdPushConstants(
-            commandBuffers[currentImage],
-            pipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT,
-            0,
-            sizeof(Model),
-            (&visualShared->GetModel()));
+        if (!bindlessTextures)
+            BindTextureDescriptors(commandBuffer, currentImage, texId);
 
+        // execute pipeline
+        vkCmdDrawIndexed(commandBuffer, mesh.GetIndexCount(), 1, 0, 0, 0);
+    }
+}
+
+void VulkanRenderer::RecordSpriteBatches(VkCommandBuffer commandBuffer, uint32_t currentImage)
+{
+    // Same order as drawing the meshes one by one, so blending comes out the same
+    spriteBatcher->Begin();
+    for (auto&& visual : Engine::m_meshes)
+    {
+        auto visualShared = visual.second.lock();
+        if (!visualShared)
+            continue;
+
+        int texId = ResolveTexture(visualShared->GetTexId(), frameNumber);
+        spriteBatcher->Add(visualShared->GetVertices(), visualShared->GetIndices(), visualShared->GetModel().m_model, visualShared->GetTextureLayer(), texId);
+    }
+    spriteBatcher->End(currentImage);
+
+    const auto& batches = spriteBatcher->GetBatches();
+    if (batches.empty())
+        return;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+    VkBuffer vertexBuffer = spriteBatcher->GetVertexBuffer(currentImage);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, spriteBatcher->GetIndexBuffer(currentImage), 0, VK_INDEX_TYPE_UINT32);
 
+    // Vertices are in world space already and carry their own layer
+    Model identity = {};
+    identity.m_model = glm::mat4(1.0f);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Model), &identity);
 
-        // Bind descriptor sets
-        if (visualShared->GetTexId() == -1)
+    if (bindlessTextures)
+        BindTextureDescriptors(commandBuffer, currentImage, -1);
+
+    for (const auto& batch : batches)
+    {
+        if (bindlessTextures)
         {
-            vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
-                0, 1, &descriptorSets[currentImage], 0, nullptr);
+            // The texture is a push constant instead of a set
+            identity.m_textureIndex = std::max(batch.texId, 0);
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Model), &identity);
         }
         else
         {
-            std::array<VkDescriptorSet, 2> descriptorSetGroup = { descriptorSets[currentImage], samplerDescriptorSets[visualShared->GetTexId()] };
-            vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
-                0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+            BindTextureDescriptors(commandBuffer, currentImage, batch.texId);
         }
+        vkCmdDrawIndexed(commandBuffer, batch.indexCount, 1, batch.firstIndex, 0, 0);
+    }
+}
 
-        // execute pipeline
-        vkCmdDrawIndexed(commandBuffers[currentImage], visualShared->GetIndexCount(), 1, 0, 0, 0);
-        
+void VulkanRenderer::RecordInstancedSprites(VkCommandBuffer commandBuffer, uint32_t currentImage)
+{
+    // Same order as drawing the meshes one by one, so blending comes out the same
+    spriteInstancer->Begin();
+    for (auto&& visual : Engine::m_meshes)
+    {
+        auto visualShared = visual.second.lock();
+        if (!visualShared)
+            continue;
+
+        int texId = ResolveTexture(visualShared->GetTexId(), frameNumber);
+        spriteInstancer->Add(visualShared->GetVertices(), visualShared->GetModel().m_model, visualShared->GetTextureLayer(), texId);
     }
+    spriteInstancer->End(currentImage);
 
-    ImDrawData* draw_data = ImGui::GetDrawData();
-    ImGui_ImplVulkan_RenderDrawData(draw_data, commandBuffers[currentImage]);
+    const auto& batches = spriteInstancer->GetBatches();
+    if (batches.empty())
+        return;
 
-    // End render pass
-    vkCmdEndRenderPass(commandBuffers[currentImage]);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, instancedPipeline);
 
-    result = vkEndCommandBuffer(commandBuffers[currentImage]);
-    if (result != VK_SUCCESS)
+    std::array<VkBuffer, 2> vertexBuffers = { spriteInstancer->GetQuadVertexBuffer(), spriteInstancer->GetInstanceBuffer(currentImage) };
+    std::array<VkDeviceSize, 2> offsets = { 0, 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(vertexBuffers.size()), vertexBuffers.data(), offsets.data());
+    vkCmdBindIndexBuffer(commandBuffer, spriteInstancer->GetQuadIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+    // One draw per texture run, every sprite of the run is an instance of the quad
+    // Bindless has a single run, the instances carry their texture index
+    if (bindlessTextures)
+        BindTextureDescriptors(commandBuffer, currentImage, -1);
+
+    if (spriteInstancer->IsIndirect() && bindlessTextures)
     {
-        throw std::runtime_error("Failed to stop recording a command buffer");
+        // Everything is in the buffers, a single call whatever the sprite count
+        VkBuffer indirectBuffer = spriteInstancer->GetCommandBuffer(currentImage);
+        uint32_t drawCount = static_cast<uint32_t>(batches.size());
+        if (indirectDrawCount)
+            vkCmdDrawIndexedIndirectCount(commandBuffer, indirectBuffer, 0, spriteInstancer->GetCountBuffer(currentImage), 0, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+        else
+            vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, 0, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+        return;
+    }
+
+    for (size_t i = 0; i < batches.size(); i++)
+    {
+        const auto& batch = batches[i];
+        if (!bindlessTextures)
+            BindTextureDescriptors(commandBuffer, currentImage, batch.texId);
+
+        // Without bindless a set is bound between runs, so a command each
+        if (spriteInstancer->IsIndirect())
+            vkCmdDrawIndexedIndirect(commandBuffer, spriteInstancer->GetCommandBuffer(currentImage), i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+        else
+            vkCmdDrawIndexed(commandBuffer, spriteInstancer->GetQuadIndexCount(), batch.instanceCount, 0, 0, batch.firstInstance);
+    }
+}
+
+void VulkanRenderer::BindTextureDescriptors(VkCommandBuffer commandBuffer, uint32_t currentImage, int texId)
+{
+    if (bindlessTextures)
+    {
+        std::array<VkDescriptorSet, 2> descriptorSetGroup = { descriptorSets[currentImage], bindlessDescriptorSet };
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+            0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+    }
+    else if (texId == -1)
+    {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+            0, 1, &descriptorSets[currentImage], 0, nullptr);
+    }
+    else
+    {
+        std::array<VkDescriptorSet, 2> descriptorSetGroup = { descriptorSets[currentImage], textures[texId].descriptor };
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+            0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
     }
 }
 
@@ -985,7 +1302,7 @@ VkExtent2D VulkanRenderer::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surf
     }
 }
 
-VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceMemory* imageMemory)
+VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propertyFlags, DeviceAllocation* imageMemory, uint32_t arrayLayers, uint32_t mipLevels)
 {
     // Create image
 
@@ -995,8 +1312,8 @@ VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height, VkFormat fo
     imageCreateInfo.extent.width = width;
     imageCreateInfo.extent.height = height;
     imageCreateInfo.extent.depth = 1;
-    imageCreateInfo.mipLevels = 1;
-    imageCreateInfo.arrayLayers = 1; 
+    imageCreateInfo.mipLevels = mipLevels;
+    imageCreateInfo.arrayLayers = arrayLayers;
     imageCreateInfo.format = format;
     imageCreateInfo.tiling = tiling;
     imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -1012,37 +1329,18 @@ VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height, VkFormat fo
         throw std::runtime_error("Failed to create an image");
     }
 
-    // Create memory for image
-
-    // Get memory requirements for a type of image
-    VkMemoryRequirements memoryRequirements;
-    vkGetImageMemoryRequirements(mainDevice.logicalDevice, image, &memoryRequirements);
-
-    // Allocate memory using requirements
-    VkMemoryAllocateInfo memoryAllocateInfo = {};
-    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex = FindMemoryTypeIndex(memoryRequirements.memoryTypeBits, propertyFlags, mainDevice.physicalDevice);
-
-    result = vkAllocateMemory(mainDevice.logicalDevice, &memoryAllocateInfo, nullptr, imageMemory);
-
-    if (result != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to allocate memory for image");
-    }
-
-    // Connect memory to image
-    vkBindImageMemory(mainDevice.logicalDevice, image, *imageMemory, 0);
+    // Memory comes from the sub-allocator, big images get a dedicated allocation there
+    *imageMemory = deviceAllocator->BindImage(image, propertyFlags);
 
     return image;
 }
 
-VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageViewType viewType, uint32_t layerCount, uint32_t mipLevels)
 {
     VkImageViewCreateInfo imageViewCreateInfo = {};
     imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     imageViewCreateInfo.image = image;
-    imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewCreateInfo.viewType = viewType;
     imageViewCreateInfo.format = format;
     imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY; // allows remmaping of rgba componnets to other values
     imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -1052,9 +1350,9 @@ VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkIm
     // Subresources allow the view to view only a part of an image
     imageViewCreateInfo.subresourceRange.aspectMask = aspectFlags; // Which asspect of image to view (e.g COLOR_BIT for viewwing color
     imageViewCreateInfo.subresourceRange.baseMipLevel = 0;         // Start mipmap level to view from 
-    imageViewCreateInfo.subresourceRange.levelCount = 1; // number of mipmap level to view
+    imageViewCreateInfo.subresourceRange.levelCount = mipLevels; // number of mipmap level to view
     imageViewCreateInfo.subresourceRange.baseArrayLayer = 0; // start array level to view from
-    imageViewCreateInfo.subresourceRange.layerCount = 1; // number of array levels to view
+    imageViewCreateInfo.subresourceRange.layerCount = layerCount; // number of array levels to view
 
     // Create image view 
     VkImageView imageView;
@@ -1166,7 +1464,7 @@ void VulkanRenderer::CreateGraphicsPipeline()
 {
     // read spir-v code of shaders
     auto vertexShaderCode = readFile("Shaders/vert.spv");
-    auto fragmentShaderCode = readFile("Shaders/frag.spv");
+    auto fragmentShaderCode = readFile(bindlessTextures ? "Shaders/frag_bindless.spv" : "Shaders/frag.spv");
 
     // Build shader modules to link to graphics pipeline 
     auto moduleVertex = CreateShaderModule(vertexShaderCode);
@@ -1208,7 +1506,7 @@ void VulkanRenderer::CreateGraphicsPipeline()
 
 
     // How the data for an attribute is defined within a vertex
-    std::array<VkVertexInputAttributeDescription, 4> attributeDescription;
+    std::array<VkVertexInputAttributeDescription, 5> attributeDescription;
 
     attributeDescription[0].binding = 0;  // Which binding the data is at (should be same as above)
     attributeDescription[0].location = 0; // Location in shader where data will be read from
@@ -1234,6 +1532,12 @@ void VulkanRenderer::CreateGraphicsPipeline()
     attributeDescription[3].format = VK_FORMAT_R32_SFLOAT;
     attributeDescription[3].offset = offsetof(Vertex, hasTexture);
 
+    // Texture layer attribute
+    attributeDescription[4].binding = 0;
+    attributeDescription[4].location = 4;
+    attributeDescription[4].format = VK_FORMAT_R32_SFLOAT;
+    attributeDescription[4].offset = offsetof(Vertex, m_textureLayer);
+
     // VERTEX INPUT 
     VkPipelineVertexInputStateCreateInfo vertexStateCreateInfo = {};
     vertexStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -1310,7 +1614,8 @@ void VulkanRenderer::CreateGraphicsPipeline()
     colorState.blendEnable = VK_TRUE; // enable blending
 
     // blending uses equation (srcColorBlendFactor * new Color) colorBlendOp(destColorBlendFactor * oldColor)
-    colorState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    // textures are premultiplied on load (TEXTURE_PIXEL_CONVERSIONS), their color already carries the alpha
+    colorState.srcColorBlendFactor = (TEXTURE_PIXEL_CONVERSIONS & PIXEL_PREMULTIPLY) ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_SRC_ALPHA;
     colorState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
     colorState.colorBlendOp = VK_BLEND_OP_ADD;
 
@@ -1332,7 +1637,7 @@ void VulkanRenderer::CreateGraphicsPipeline()
 
     // -- PIPELINE LAYOUT 
 
-    std::array<VkDescriptorSetLayout, 2> descriptorSetlayouts = { descriptorSetLayout, samplerSetLayout };
+    std::array<VkDescriptorSetLayout, 2> descriptorSetlayouts = { descriptorSetLayout, bindlessTextures ? bindlessSetLayout : samplerSetLayout };
 
     VkPipelineLayoutCreateInfo pipelineCreateInfo = {};
     pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -1410,6 +1715,50 @@ void VulkanRenderer::CreateGraphicsPipeline()
     vkDestroyShaderModule(mainDevice.logicalDevice, moduleFragment, nullptr);
     vkDestroyShaderModule(mainDevice.logicalDevice, moduleVertex, nullptr);
 
+    // -- INSTANCED PIPELINE --
+    // Same layout and fixed function state, shared unit quad at binding 0 and a SpriteInstance per instance at binding 1
+    auto instancedVertexShaderCode = readFile("Shaders/vert_instanced.spv");
+    auto instancedFragmentShaderCode = readFile(bindlessTextures ? "Shaders/frag_instanced_bindless.spv" : "Shaders/frag_instanced.spv");
+    shaderStages[0].module = CreateShaderModule(instancedVertexShaderCode);
+    shaderStages[1].module = CreateShaderModule(instancedFragmentShaderCode);
+
+    std::array<VkVertexInputBindingDescription, 2> instancedBindings = {};
+    instancedBindings[0].binding = 0;
+    instancedBindings[0].stride = sizeof(Vertex);
+    instancedBindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    instancedBindings[1].binding = 1;
+    instancedBindings[1].stride = sizeof(SpriteInstance);
+    instancedBindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    std::array<VkVertexInputAttributeDescription, 11> instancedAttributes = {};
+    instancedAttributes[0] = { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, m_position) };
+    instancedAttributes[1] = { 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, m_tex) };
+    // mat4 is read as four vec4 columns
+    for (uint32_t column = 0; column < 4; column++)
+    {
+        instancedAttributes[2 + column] = { 2 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(SpriteInstance, m_transform) + column * sizeof(glm::vec4)) };
+    }
+    instancedAttributes[6] = { 6, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SpriteInstance, m_uvRect) };
+    instancedAttributes[7] = { 7, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SpriteInstance, m_tint) };
+    instancedAttributes[8] = { 8, 1, VK_FORMAT_R32_SFLOAT, offsetof(SpriteInstance, m_textureLayer) };
+    instancedAttributes[9] = { 9, 1, VK_FORMAT_R32_SFLOAT, offsetof(SpriteInstance, m_hasTexture) };
+    instancedAttributes[10] = { 10, 1, VK_FORMAT_R32_SINT, offsetof(SpriteInstance, m_textureIndex) };
+
+    vertexStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(instancedBindings.size());
+    vertexStateCreateInfo.pVertexBindingDescriptions = instancedBindings.data();
+    vertexStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedAttributes.size());
+    vertexStateCreateInfo.pVertexAttributeDescriptions = instancedAttributes.data();
+
+    result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineGraphicsCreateInfo, nullptr, &instancedPipeline);
+
+    vkDestroyShaderModule(mainDevice.logicalDevice, shaderStages[1].module, nullptr);
+    vkDestroyShaderModule(mainDevice.logicalDevice, shaderStages[0].module, nullptr);
+
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Could not create instanced graphics pipeline");
+    }
+
 }
 
 VkShaderModule VulkanRenderer::CreateShaderModule(const std::vector<char>& code)
@@ -1436,6 +1785,8 @@ void VulkanRenderer::CreateSynchronisation()
     imageAvailable.resize(MAX_FRAME_DRAWS);
     renderFinished.resize(MAX_FRAME_DRAWS);
     drawFences.resize(MAX_FRAME_DRAWS);
+    imageFences.assign(swapChainImages.size(), VK_NULL_HANDLE);
+    retainedSceneVersions.assign(swapChainImages.size(), NOT_RECORDED);
 
 
     // Semaphore creation information
@@ -1515,6 +1866,33 @@ void VulkanRenderer::CreateDescriptorSetLayout()
     {
         throw std::runtime_error("Failed to create descriptor set layout");
     }
+
+    if (!bindlessTextures)
+        return;
+
+    // Bindless texture layout, same binding as one array holding every texture
+    VkDescriptorSetLayoutBinding bindlessLayoutBinding = samplerLayoutBinding;
+    bindlessLayoutBinding.descriptorCount = bindlessTextureCapacity;
+
+    // Slots fill up as textures are created, written while the set is bound and while frames drawing other slots are in flight
+    VkDescriptorBindingFlags bindlessFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {};
+    bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsCreateInfo.bindingCount = 1;
+    bindingFlagsCreateInfo.pBindingFlags = &bindlessFlags;
+
+    VkDescriptorSetLayoutCreateInfo bindlessLayoutCreateInfo = {};
+    bindlessLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    bindlessLayoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+    bindlessLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    bindlessLayoutCreateInfo.bindingCount = 1;
+    bindlessLayoutCreateInfo.pBindings = &bindlessLayoutBinding;
+
+    result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &bindlessLayoutCreateInfo, nullptr, &bindlessSetLayout);
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create bindless descriptor set layout");
+    }
 }
 
 void VulkanRenderer::CreatePushConstantRange()
@@ -1593,6 +1971,26 @@ void VulkanRenderer::CreateDescriptorPool()
 
     result = vkCreateDescriptorPool(mainDevice.logicalDevice, &samplerPoolCreateInfo, nullptr, &samplerDescriptorPool);
 
+    if (!bindlessTextures)
+        return;
+
+    // Bindless pool, holds the one set with every texture
+    VkDescriptorPoolSize bindlessPoolSize = {};
+    bindlessPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindlessPoolSize.descriptorCount = bindlessTextureCapacity;
+
+    VkDescriptorPoolCreateInfo bindlessPoolCreateInfo = {};
+    bindlessPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    bindlessPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    bindlessPoolCreateInfo.maxSets = 1;
+    bindlessPoolCreateInfo.poolSizeCount = 1;
+    bindlessPoolCreateInfo.pPoolSizes = &bindlessPoolSize;
+
+    result = vkCreateDescriptorPool(mainDevice.logicalDevice, &bindlessPoolCreateInfo, nullptr, &bindlessDescriptorPool);
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create bindless descriptor pool");
+    }
 }
 
 void VulkanRenderer::CreateDescriptorSets()
@@ -1657,85 +2055,415 @@ void VulkanRenderer::CreateDescriptorSets()
         vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(descriptorSetsWrites.size()), descriptorSetsWrites.data(), 0, nullptr);
     }
 
+    if (bindlessTextures)
+    {
+        VkDescriptorSetAllocateInfo bindlessAllocInfo = {};
+        bindlessAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        bindlessAllocInfo.descriptorPool = bindlessDescriptorPool;
+        bindlessAllocInfo.descriptorSetCount = 1;
+        bindlessAllocInfo.pSetLayouts = &bindlessSetLayout;
+
+        result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &bindlessAllocInfo, &bindlessDescriptorSet);
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate bindless descriptor set");
+        }
+    }
+
+}
+
+int VulkanRenderer::CreateTextureImage(const stbi_uc* imageData, uint32_t width, uint32_t height, TexturePackFormat format, uint32_t mipLevels)
+{
+    TextureInfo info = textureUploader->MakeInfo(width, height, 1, format, mipLevels);
+
+    // Pixels are copied to staging here, so imageData can be freed as soon as this returns
+    TextureRecord texture;
+    texture.image = textureUploader->Upload(info, imageData, &texture.memory);
+    texture.info = info;
+    texture.view = textureUploader->CreateView(texture.image, info);
+
+    int texId = AddTexture(texture, texture.view);
+    TextureUploaded(texId);
+    return texId;
+}
+
+bool VulkanRenderer::IsTextureFormatSupported(TexturePackFormat format) const
+{
+    return textureUploader->IsFormatSupported(format);
+}
+
+int VulkanRenderer::CreateTexture(std::string fileName)
+{
+    return textureRegistry.GetOrLoad(fileName, [&]()
+    {
+        int width, height;
+        VkDeviceSize imageSize;
+        auto imageData = LoadTextureFile(fileName, &width, &height, &imageSize);
+
+        int texId = CreateTextureImage(imageData, static_cast<uint32_t>(width), static_cast<uint32_t>(height), TexturePackFormat::RGBA8, 1);
+        SetTextureSource(texId, 0, { nullptr, 0, fileName });
+
+        // Free original data
+        stbi_image_free(imageData);
+
+        return texId;
+    });
+}
+
+int VulkanRenderer::CreateTextureAsync(const std::string& fileName)
+{
+    return textureRegistry.GetOrLoad(fileName, [&]()
+    {
+        if (placeholderTexture == -1)
+            throw std::runtime_error("Async textures need a placeholder texture");
+
+        // Empty slot until the upload, its set shows the placeholder so it is valid from the start
+        int texId = AddTexture(TextureRecord(), textures[placeholderTexture].view);
+
+        loadingTextures[texId] = { fileName, 0 };
+        asyncTextureLoader->Request(texId, fileName);
+        return texId;
+    });
+}
+
+int VulkanRenderer::CreateTexture(const std::string& fileName, const stbi_uc* imageData, int width, int height, VkDeviceSize imageSize)
+{
+    return CreateTexture(fileName, imageData, static_cast<uint32_t>(width), static_cast<uint32_t>(height), TexturePackFormat::RGBA8, 1);
+}
+
+int VulkanRenderer::CreateTexture(const std::string& fileName, const stbi_uc* data, uint32_t width, uint32_t height, TexturePackFormat format, uint32_t mipLevels)
+{
+    return textureRegistry.GetOrLoad(fileName, [&]() { return CreateTextureImage(data, width, height, format, mipLevels); });
+}
+
+int VulkanRenderer::BeginTextureArray(uint32_t width, uint32_t height, uint32_t layerCount, TexturePackFormat format, uint32_t mipLevels)
+{
+    TextureInfo info = textureUploader->MakeInfo(width, height, layerCount, format, mipLevels);
+
+    // One image for all layers, stays in TRANSFER_DST until EndTextureArray
+    DeviceAllocation texImageMemory;
+    VkImage texImage = textureUploader->CreateImage(info, &texImageMemory);
+
+    uploadBatch->Begin();
+    uploadBatch->EnqueueImageTransition(texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layerCount, info.mipLevels);
+    uploadBatch->End();
+
+    TextureRecord texture;
+    texture.image = texImage;
+    texture.memory = texImageMemory;
+    texture.info = info;
+    texture.view = textureUploader->CreateView(texImage, info);
+    return AddTexture(texture, texture.view);
+}
+
+void VulkanRenderer::UploadTextureArrayLayers(int texId, uint32_t firstLayer, uint32_t layerCount, const stbi_uc* const* layers)
+{
+    const TextureInfo& info = textures[texId].info;
+
+    uploadBatch->Begin();
+    for (uint32_t layer = 0; layer < layerCount; layer++)
+    {
+        textureUploader->EnqueueLayer(textures[texId].image, info, firstLayer + layer, layers[layer]);
+    }
+    uploadBatch->End();
+}
+
+bool VulkanRenderer::ReserveTextureLayer(int texId, UploadBatch::ImageWrite* write)
+{
+    const TextureInfo& info = textures[texId].info;
+    if (info.imageFormat != VK_FORMAT_R8G8B8A8_UNORM || IsBlockCompressed(info.format) || (info.mipLevels > 1 && !textureUploader->GetBlitMipmaps()))
+        return false;
+
+    return uploadBatch->ReserveImageWrite(static_cast<VkDeviceSize>(info.width) * info.height * 4, write);
+}
+
+void VulkanRenderer::CommitTextureLayer(int texId, uint32_t layer, const UploadBatch::ImageWrite& write)
+{
+    const TextureInfo& info = textures[texId].info;
+
+    uploadBatch->Begin();
+    uploadBatch->CommitImageWrite(write, textures[texId].image, info.width, info.height, layer, 1);
+    uploadBatch->End();
 }
 
-int VulkanRenderer::CreateTextureImage(std::string fileName)
+void VulkanRenderer::CancelTextureLayer(const UploadBatch::ImageWrite& write)
 {
-    int width, height;
-    VkDeviceSize imageSize;
-    auto imageData = LoadTextureFile(fileName, &width, &height, &imageSize);
+    uploadBatch->CancelImageWrite(write);
+}
 
-    if (USE_THREAD_LOADING)
+void VulkanRenderer::EndTextureArray(int texId)
+{
+    uploadBatch->Begin();
+    textureUploader->EnqueueFinish(textures[texId].image, textures[texId].info);
+    uploadBatch->End();
+
+    // Half filled arrays are never evicted, only count them once every layer is in
+    TextureUploaded(texId);
+}
+
+void VulkanRenderer::UpdateTextureRegion(int texId, int32_t x, int32_t y, uint32_t width, uint32_t height, const void* data, size_t rowPitch, uint32_t layer)
+{
+    if (texId < 0 || texId >= static_cast<int>(textures.size()))
+        throw std::runtime_error("Texture region update of an unknown texture");
+    if (IsTextureLoading(texId) || textures[texId].image == VK_NULL_HANDLE || (textureResidency && !textureResidency->IsResident(texId)))
+        throw std::runtime_error("Texture region update of a texture that isn't resident");
+    if (textureRegistry.IsShared(texId))
+        throw std::runtime_error("Texture region update of a texture deduplicated frames share, it would change all of them");
+
+    const TextureInfo& info = textures[texId].info;
+    if (info.imageFormat != VK_FORMAT_R8G8B8A8_UNORM)
+        throw std::runtime_error("Texture region updates need an RGBA8 texture");
+    if (info.mipLevels > 1 && !textureUploader->GetBlitMipmaps())
+        throw std::runtime_error("Texture region updates need blitted mips, the CPU made ones would keep the old image");
+    if (x < 0 || y < 0 || x + width > info.width || y + height > info.height || layer >= info.layerCount)
+        throw std::runtime_error("Texture region is outside of the texture");
+    if (width == 0 || height == 0)
+        return;
+
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    if (rowPitch == 0)
+        rowPitch = rowSize;
+
+    // Same conversions as files get on load
+    ScratchArena::Scope scratch(ScratchArena::ForThread());
+    if (TEXTURE_PIXEL_CONVERSIONS)
     {
-        std::unique_lock<std::recursive_mutex> lock(AnimationLoader::m_lock);
-        memoryUsed += imageSize;
-        lock.unlock();
+        uint8_t* converted = ScratchArena::ForThread().Allocate(rowSize * height);
+        for (uint32_t row = 0; row < height; row++)
+            memcpy(converted + row * rowSize, static_cast<const uint8_t*>(data) + row * rowPitch, rowSize);
+        ConvertPixels(converted, width, height, rowSize, TEXTURE_PIXEL_CONVERSIONS);
+        data = converted;
+        rowPitch = rowSize;
     }
+
+    // Only the updated layer leaves SHADER_READ_ONLY, its whole chain since the mips are blitted from level 0
+    // Every level only gets the rectangle's footprint blitted again, the other layers are drawn from meanwhile
+    VkImage image = textures[texId].image;
+
+    uploadBatch->Begin();
+    uploadBatch->EnqueueImageTransition(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, info.mipLevels, layer);
+    uploadBatch->EnqueueImageRegionCopy(data, rowPitch, image, x, y, width, height, layer);
+    if (info.mipLevels > 1)
+        uploadBatch->EnqueueMipGeneration(image, info.width, info.height, 1, info.mipLevels, layer, { { x, y }, { width, height } });
     else
+        uploadBatch->EnqueueImageTransition(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, 1, layer);
+    uploadBatch->End();
+
+    // Reloading the file would lose the update, and the content hash no longer matches
+    if (textureResidency)
+        textureResidency->Pin(texId);
+    textureRegistry.ForgetContent(texId);
+}
+
+void VulkanRenderer::SetTextureSource(int texId, uint32_t layer, TextureLayerSource source)
+{
+    if (textureResidency)
+        textureResidency->SetSource(texId, layer, std::move(source));
+}
+
+void VulkanRenderer::SetPlaceholderTexture(int texId)
+{
+    placeholderTexture = texId;
+    Engine::MarkSceneDirty();
+    if (textureResidency)
+        textureResidency->Pin(texId);
+}
+
+void VulkanRenderer::SetTextureBudget(VkDeviceSize budget)
+{
+    if (!textureResidency)
+        return;
+    textureResidency->SetBudget(budget);
+    EnforceTextureBudget();
+}
+
+void VulkanRenderer::TextureUploaded(int texId)
+{
+    // Draws of texId stop resolving to the placeholder
+    Engine::MarkSceneDirty();
+    if (!textureResidency)
+        return;
+    textureResidency->MakeResident(texId, textures[texId].memory.size, textures[texId].info.width, textures[texId].info.height, textures[texId].info.layerCount, frameNumber);
+    EnforceTextureBudget();
+}
+
+int VulkanRenderer::ResolveTexture(int texId, uint64_t frame)
+{
+    if (texId == -1)
+        return texId;
+
+    // Never binding the set of a loading texture is what makes rewriting it later safe
+    if (!loadingTextures.empty() && loadingTextures.count(texId))
+        return placeholderTexture;
+
+    if (!textureResidency)
+        return texId;
+
+    textureResidency->Touch(texId, frame);
+    sceneTextures.insert(texId);
+    return textureResidency->IsResident(texId) ? texId : placeholderTexture;
+}
+
+void VulkanRenderer::UpdateAsyncTextures()
+{
+    if (loadingTextures.empty())
+        return;
+
+    // Decoded since the last frame, uploads go into the batch without waiting for them
+    AsyncTexture loaded;
+    while (asyncTextureLoader->PopLoaded(loaded))
     {
-        memoryUsed += imageSize;
+        int texId = loaded.texId;
+        if (!loaded.pixels)
+        {
+            // Its set keeps showing the placeholder, the next CreateTextureAsync of the file tries again
+            ReportError("Failed to load an image: " + loaded.fileName);
+            textureRegistry.Remove(loaded.fileName);
+            loadingTextures.erase(texId);
+            continue;
+        }
+
+        TextureInfo info = textureUploader->MakeInfo(static_cast<uint32_t>(loaded.width), static_cast<uint32_t>(loaded.height), 1, TexturePackFormat::RGBA8, 1);
+
+        TextureRecord& texture = textures[texId];
+        texture.image = textureUploader->Upload(info, loaded.pixels, &texture.memory, true);
+        texture.info = info;
+        texture.view = textureUploader->CreateView(texture.image, info);
+        loaded.Release();
+        loadingTextures[texId].submit = uploadBatch->GetEnqueuedSubmit();
     }
-    
 
-    // Creating staging buffer to hold loaded data
-    VkBuffer imageStagingBuffer;
-    VkDeviceMemory imageStagingBufferMemory;
-    CreateBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &imageStagingBuffer, &imageStagingBufferMemory);
+    // Handles switch over between frames, draws recorded from here on bind the real texture
+    for (auto it = loadingTextures.begin(); it != loadingTextures.end();)
+    {
+        if (it->second.submit == 0 || !uploadBatch->IsSubmitComplete(it->second.submit))
+        {
+            ++it;
+            continue;
+        }
 
-    // Copy image data to staging buffer
-    void* data;
-    vkMapMemory(mainDevice.logicalDevice, imageStagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, imageData, static_cast<size_t>(imageSize));
-    vkUnmapMemory(mainDevice.logicalDevice, imageStagingBufferMemory);
+        int texId = it->first;
+        WriteTextureDescriptor(texId, textures[texId].view);
+        SetTextureSource(texId, 0, { nullptr, 0, it->second.fileName });
+        it = loadingTextures.erase(it);
+        TextureUploaded(texId);
+    }
+}
 
-    // Free original data
-    stbi_image_free(imageData);
+void VulkanRenderer::UpdateTextureResidency()
+{
+    if (!textureResidency)
+        return;
 
-    // Create image to hold final texture
-    VkImage texImage;
-    VkDeviceMemory texImageMemory;
+    // Textures the streaming thread read back since the last frame
+    StreamedTexture streamed;
+    while (textureResidency->PopStreamed(streamed))
+    {
+        if (streamed.failed)
+        {
+            ReportError("Failed to stream texture " + std::to_string(streamed.texId) + " back in");
+            textureResidency->StreamFailed(streamed.texId);
+        }
+        else
+        {
+            RestoreTexture(streamed);
+        }
+        streamed.Release();
+    }
 
-    texImage = CreateImage(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texImageMemory);
+    // Same hand over as async textures, until the copies are done draws keep the placeholder
+    for (auto it = restoringTextures.begin(); it != restoringTextures.end();)
+    {
+        if (!uploadBatch->IsSubmitComplete(it->submit))
+        {
+            ++it;
+            continue;
+        }
 
-    std::unique_lock<std::recursive_mutex> lock(AnimationLoader::m_lock);
-    // Trainsition image to be dst for copy operation
-    TransitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        // Draws bound the placeholder while the texture was out, so no pending command buffer uses this set
+        TextureRecord& texture = textures[it->texId];
+        WriteTextureDescriptor(it->texId, texture.view);
+        textureResidency->MakeResident(it->texId, texture.memory.size, texture.info.width, texture.info.height, texture.info.layerCount, frameNumber);
+        Engine::MarkSceneDirty();
+        it = restoringTextures.erase(it);
+    }
 
-    // copy image to data
-    CopyImageBuffer(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, imageStagingBuffer, texImage, width, height);
+    EnforceTextureBudget();
+}
 
-    // Trasnition image to be shader readable
-    TransitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    lock.unlock();
+void VulkanRenderer::EnforceTextureBudget()
+{
+    DestroyRetiredTextures();
 
-    // Add texture data to vector for reference
-    textureImages.push_back(texImage);
-    textureImageMemory.push_back(texImageMemory);
+    std::vector<int> evictions = textureResidency->CollectEvictions(completedFrames);
+    if (evictions.empty())
+        return;
 
-    // Destroy stagin buffers
-    vkDestroyBuffer(mainDevice.logicalDevice, imageStagingBuffer, nullptr);
-    vkFreeMemory(mainDevice.logicalDevice, imageStagingBufferMemory, nullptr);
+    // Draws that used these images are done already, copies into them may still be queued or running
+    size_t submit = uploadBatch->GetEnqueuedSubmit();
+    for (int texId : evictions)
+    {
+        TextureRecord& texture = textures[texId];
+        uploadBatch->ForgetImage(texture.image);
+        retiredTextures.push_back({ texture.image, texture.memory, texture.view, submit });
+        texture.memory = {};
+        texture.view = VK_NULL_HANDLE;
+        texture.image = VK_NULL_HANDLE;
+        textureResidency->MakeEvicted(texId);
+    }
 
-    // Return index of new texture image
-    return textureImages.size() - 1;
+    // Evicted textures resolve to the placeholder, recorded scenes still point at the retired views
+    Engine::MarkSceneDirty();
 }
 
-int VulkanRenderer::CreateTexture(std::string fileName)
+void VulkanRenderer::DestroyRetiredTextures()
 {
-    if (imagesID.find(fileName) != imagesID.end())
-        return imagesID[fileName];
+    // Submits finish in order, and retiredTextures was filled in submit order
+    size_t done = 0;
+    while (done < retiredTextures.size() && uploadBatch->IsSubmitComplete(retiredTextures[done].submit))
+    {
+        RetiredTexture& retired = retiredTextures[done++];
+        vkDestroyImageView(mainDevice.logicalDevice, retired.view, nullptr);
+        deviceAllocator->DestroyImage(retired.image, retired.memory);
+    }
+    retiredTextures.erase(retiredTextures.begin(), retiredTextures.begin() + done);
+}
+
+void VulkanRenderer::RestoreTexture(const StreamedTexture& streamed)
+{
+    int texId = streamed.texId;
+    const TextureInfo& info = textures[texId].info;
 
-    // Create TextureImage and get its location in array
-    int textureImageLoc = CreateTextureImage(fileName);
+    DeviceAllocation texImageMemory;
+    VkImage texImage = textureUploader->CreateImage(info, &texImageMemory);
+    uploadBatch->UploadOnTransferQueue(texImage);
 
-    VkImageView imageView = CreateImageView(textureImages[textureImageLoc], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
-    textureImageViews.push_back(imageView);
+    uploadBatch->Begin();
+    uploadBatch->EnqueueImageTransition(texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, info.layerCount, info.mipLevels);
+    for (uint32_t layer = 0; layer < info.layerCount; layer++)
+    {
+        textureUploader->EnqueueLayer(texImage, info, layer, streamed.layers[layer]);
+    }
+    textureUploader->EnqueueFinish(texImage, info);
+    uploadBatch->End();
 
-    int descriptorLoc = CreateTextureDescriptor(imageView);
+    TextureRecord& texture = textures[texId];
+    texture.image = texImage;
+    texture.memory = texImageMemory;
+    texture.view = textureUploader->CreateView(texImage, info);
+    restoringTextures.push_back({ texId, uploadBatch->GetEnqueuedSubmit() });
+}
+
+uint32_t VulkanRenderer::GetMaxTextureArrayLayers()
+{
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
+    return deviceProperties.limits.maxImageArrayLayers;
+}
 
-    imagesID[fileName] = descriptorLoc;
-    return descriptorLoc;
+void VulkanRenderer::ReserveTextures(size_t count)
+{
+    textures.reserve(textures.size() + count);
 }
 
 void VulkanRenderer::CreateTextureSampler()
@@ -1753,7 +2481,7 @@ void VulkanRenderer::CreateTextureSampler()
     samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;     // MipMap interpolaton mode
     samplerCreateInfo.mipLodBias = 0.0f;                              // Level of details bias for mip level
     samplerCreateInfo.minLod = 0.0f;                                  // Minimum level of detail to pick mip level 
-    samplerCreateInfo.maxLod = 0.0f;                                  // Maximum level of detail to pick mip level
+    samplerCreateInfo.maxLod = GENERATE_MIPMAPS ? VK_LOD_CLAMP_NONE : 0.0f; // Maximum level of detail to pick mip level, whole chain when mips are generated
     samplerCreateInfo.anisotropyEnable = VK_TRUE;                     // Enable anisotropy
     samplerCreateInfo.maxAnisotropy = 16;                             // Antisotropy sample level
 
@@ -1765,7 +2493,7 @@ void VulkanRenderer::CreateTextureSampler()
     }
 }
 
-int VulkanRenderer::CreateTextureDescriptor(VkImageView textureImage)
+VkDescriptorSet VulkanRenderer::CreateTextureDescriptor()
 {
     VkDescriptorSet descriptorSetLocal;
 
@@ -1784,6 +2512,27 @@ int VulkanRenderer::CreateTextureDescriptor(VkImageView textureImage)
         throw std::runtime_error("Failed to allocate texture descriptor sets!");
     }
 
+    return descriptorSetLocal;
+}
+
+int VulkanRenderer::AddTexture(const TextureRecord& texture, VkImageView descriptorView)
+{
+    // Descriptor first, so a failed allocation leaves no half made record behind
+    VkDescriptorSet descriptor = VK_NULL_HANDLE;
+    if (!bindlessTextures)
+        descriptor = CreateTextureDescriptor();
+    else if (textures.size() >= bindlessTextureCapacity)
+        throw std::runtime_error("Bindless texture array is full");
+
+    textures.push_back(texture);
+    textures.back().descriptor = descriptor;
+    int texId = static_cast<int>(textures.size() - 1);
+    WriteTextureDescriptor(texId, descriptorView);
+    return texId;
+}
+
+void VulkanRenderer::WriteTextureDescriptor(int texId, VkImageView textureImage)
+{
     VkDescriptorImageInfo imageInfo = {};
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; // Image layout when in use
     imageInfo.imageView = textureImage;
@@ -1792,21 +2541,15 @@ int VulkanRenderer::CreateTextureDescriptor(VkImageView textureImage)
     // Descriptor write info
     VkWriteDescriptorSet descriptorWrite = {};
     descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrite.dstSet = descriptorSetLocal;
+    descriptorWrite.dstSet = bindlessTextures ? bindlessDescriptorSet : textures[texId].descriptor;
     descriptorWrite.dstBinding = 0;
-    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.dstArrayElement = bindlessTextures ? static_cast<uint32_t>(texId) : 0;
     descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrite.descriptorCount = 1;
     descriptorWrite.pImageInfo = &imageInfo;
 
     // Update new descriptor set 
     vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &descriptorWrite, 0, nullptr);
-
-    // Add descriptor set to list
-    samplerDescriptorSets.push_back(descriptorSetLocal);
-
-    // Return descriptor set location
-    return samplerDescriptorSets.size() - 1;
 }
 
 void VulkanRenderer::UpdateUniformBuffer(uint32_t imageIndex)
@@ -1830,31 +2573,33 @@ void VulkanRenderer::UpdateUniformBuffer(uint32_t imageIndex)
 
 stbi_uc* VulkanRenderer::LoadTextureFile(std::string fileName, int* width, int* height, VkDeviceSize* imageSize)
 {
-    // Number of channels image uses
-    int channels;
-
-    // load pixel data for image
-    std::string fileLoc = fileName;
-    stbi_uc* image = stbi_load(fileLoc.c_str(), width, height, &channels, STBI_rgb_alpha);
+    // load pixel data for image, straight from the decoded cache when the file was seen before
+    stbi_uc* image = LoadImageCached(fileName, width, height);
 
     if (!image)
     {
         throw std::runtime_error("Failed to load an image: " + fileName);
     }
 
+    // premultiply etc. here, this still runs on the decode thread
+    ConvertPixels(image, static_cast<uint32_t>(*width), static_cast<uint32_t>(*height), static_cast<size_t>(*width) * 4, TEXTURE_PIXEL_CONVERSIONS);
 
-    *imageSize = static_cast<long>(*width) * static_cast<long>(*height) * 4;
+    *imageSize = static_cast<VkDeviceSize>(*width) * static_cast<VkDeviceSize>(*height) * 4;
 
     return image;
 }
 
+void VulkanRenderer::ReportError(const std::string& message)
+{
+    std::cerr << "ERROR: " << message << std::endl;
+}
+
 VulkanRenderer::VulkanRenderer()
 {
     std::random_device randomDevice;
     mt = std::mt19937(randomDevice());
     distribution = std::uniform_real_distribution<float>(-0.25f, 0.25f);
     colorDistribution = std::uniform_real_distribution<float>(0.0f, 1.0f);
-    memoryUsed = 0;
 }
 
 VulkanRenderer::~VulkanRenderer()
@@ -1873,6 +2618,7 @@ int VulkanRenderer::Init(GLFWwindow* newWindow)
         CreateSurface();
         GetPhysicalDevice();
         CreateLogicalDevice();
+        deviceAllocator = std::make_unique<DeviceAllocator>(mainDevice.physicalDevice, mainDevice.logicalDevice);
         CreateSwapChain();
         CreateRenderPass();
         CreateDescriptorSetLayout();
@@ -1881,6 +2627,25 @@ int VulkanRenderer::Init(GLFWwindow* newWindow)
         CreateDepthBufferImage();
         CreateFramebuffers();
         CreateCommandPool();
+        uploadBatch = std::make_unique<UploadBatch>(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool);
+        spriteBatcher = std::make_unique<SpriteBatcher>(*deviceAllocator, static_cast<uint32_t>(swapChainImages.size()));
+        if (transferQueue != VK_NULL_HANDLE)
+        {
+            QueueFamilyIndices indices = GetQueueFamilies(mainDevice.physicalDevice);
+            uploadBatch->UseTransferQueue(transferQueue, transferCommandPool, indices.transferFamily, indices.graphicsFamily);
+        }
+        textureUploader = std::make_unique<TextureUploader>(mainDevice.physicalDevice, mainDevice.logicalDevice, *deviceAllocator, *uploadBatch, textureCompressionBC);
+        spriteInstancer = std::make_unique<SpriteInstancer>(*deviceAllocator, *uploadBatch, static_cast<uint32_t>(swapChainImages.size()), bindlessTextures, indirectDraws);
+        if (USE_THREADED_RECORDING)
+        {
+            size_t recordingThreads = RECORDING_THREADS ? RECORDING_THREADS : std::max(1u, std::thread::hardware_concurrency());
+            // A set per frame in flight for ImGui, then a set per swapchain image for the scene
+            uint32_t setCount = MAX_FRAME_DRAWS + static_cast<uint32_t>(swapChainImages.size());
+            secondaryRecorder = std::make_unique<SecondaryRecorder>(mainDevice.logicalDevice, GetQueueFamilies(mainDevice.physicalDevice).graphicsFamily, setCount, recordingThreads);
+        }
+        if (USE_TEXTURE_RESIDENCY)
+            textureResidency = std::make_unique<TextureResidency>(TEXTURE_MEMORY_BUDGET);
+        asyncTextureLoader = std::make_unique<AsyncTextureLoader>(ASYNC_TEXTURE_THREADS);
         CreateTextureSampler();
         CreateCommandBuffers();
     //    AllocateDynamicBuffer();
@@ -1925,11 +2690,9 @@ int VulkanRenderer::Init(GLFWwindow* newWindow)
     }
     catch (const std::runtime_error& exeption)
     {
-        std::cout << "ERROR: " << exeption.what() << std::endl;
+        ReportError(exeption.what());
         return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
 }
-
-std::unordered_map<std::string, int> VulkanRenderer::imagesID;
\ No newline at end of file
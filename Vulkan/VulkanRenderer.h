@@ -23,8 +23,22 @@
 #include "AnimationLoader.h"
 #include "Utilites.h"
 #include <unordered_map>
+#include <unordered_set>
 #include <assert.h>
 #include "Engine.h"
+#include "UploadBatch.h"
+#include "DeviceAllocator.h"
+#include "MipMaps.h"
+#include "BlockCompression.h"
+#include "TextureResidency.h"
+#include "AsyncTextureLoader.h"
+#include "ContentHash.h"
+#include "TextureCache.h"
+#include "TextureRegistry.h"
+#include "SpriteBatcher.h"
+#include "SpriteInstancer.h"
+#include "SecondaryRecorder.h"
+#include "TextureUploader.h"
 
 class VulkanRenderer
 {
@@ -38,10 +52,11 @@ private:
 
 	friend class AnimationLoader;
 	friend class Engine;
-	long long unsigned int memoryUsed;
+	std::unique_ptr<DeviceAllocator> deviceAllocator;
 
 	VkQueue graphicsQueue;
 	VkQueue presentationQueue;
+	VkQueue transferQueue = VK_NULL_HANDLE;
 	VkSurfaceKHR surface;
 	VkSwapchainKHR swapchain;
 
@@ -62,7 +77,7 @@ private:
 
 
 	VkImage depthBufferImage;
-	VkDeviceMemory depthBufferImageMemory;
+	DeviceAllocation depthBufferImageMemory;
 	VkImageView depthBufferImageView;
 	VkFormat depthFormat;
 
@@ -73,8 +88,16 @@ private:
 
 	VkDescriptorPool descriptorPool;
 	VkDescriptorPool samplerDescriptorPool;
+
+	// Bindless mode, every texture is element texId of one sampler array, picked in the shader by index
+	bool bindlessTextures = false;            // USE_BINDLESS_TEXTURES and the device has descriptor indexing
+	uint32_t bindlessTextureCapacity = 0;     // size of the array, texIds past it can't be created
+	bool indirectDraws = false;               // USE_INDIRECT_DRAWS and the device has drawIndirectFirstInstance
+	bool indirectDrawCount = false;           // ... and drawIndirectCount, the number of draws comes from a buffer
+	VkDescriptorSetLayout bindlessSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool bindlessDescriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet bindlessDescriptorSet = VK_NULL_HANDLE;
 	std::vector<VkDescriptorSet> descriptorSets;
-	std::vector<VkDescriptorSet> samplerDescriptorSets;
 
 	std::vector<VkBuffer> uniformBuffer;
 	std::vector<VkDeviceMemory> uniformBufferMemory;
@@ -91,9 +114,31 @@ private:
 	VkExtent2D swapChainExtent;
 
 	VkCommandPool graphicsCommandPool;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+	std::unique_ptr<UploadBatch> uploadBatch;
+	std::unique_ptr<TextureUploader> textureUploader;
+	std::unique_ptr<SpriteBatcher> spriteBatcher;
+	std::unique_ptr<SpriteInstancer> spriteInstancer;
+	std::unique_ptr<SecondaryRecorder> secondaryRecorder; // null when recording inline
+
+	// Meshes of this frame with their resolved texture, read by the recording threads
+	struct MeshDraw
+	{
+		std::shared_ptr<Mesh> mesh;
+		int texId;
+	};
+	std::vector<MeshDraw> meshDraws;
+
+	// Engine::m_sceneVersion each image's scene secondaries were recorded at
+	static constexpr uint64_t NOT_RECORDED = ~0ull;
+	std::vector<uint64_t> retainedSceneVersions;
+	std::unordered_set<int> sceneTextures; // textures resolved by the last scene recording, touched while it is reused
 
 	GLFWwindow* window;
 	int currentFrame = 0;
+	uint64_t frameNumber = 0;     // frames drawn so far
+	uint64_t completedFrames = 0; // frames below this number have finished on the GPU
+	float recordMilliseconds = 0.0f;
 	// Vulkan components
 	VkInstance instance;
 	
@@ -102,6 +147,7 @@ private:
 
 	VkRenderPass renderPass;
 	VkPipeline graphicsPipeline;
+	VkPipeline instancedPipeline;
 
 	// vulkan functions
 	void CreateInstance();
@@ -143,6 +189,16 @@ private:
 	// Record functions
 
 	void RecordCommands(uint32_t currentImage);
+	void RecordScene(VkCommandBuffer commandBuffer, uint32_t currentImage);
+	void RecordSecondaries(uint32_t currentImage);
+	void RecordMeshes(VkCommandBuffer commandBuffer, uint32_t currentImage);
+	void CollectMeshDraws();
+	// Safe on any thread, only reads meshDraws
+	void RecordMeshRange(VkCommandBuffer commandBuffer, uint32_t currentImage, size_t first, size_t last);
+	void RecordSpriteBatches(VkCommandBuffer commandBuffer, uint32_t currentImage);
+	void RecordInstancedSprites(VkCommandBuffer commandBuffer, uint32_t currentImage);
+	// Bindless mode binds the whole array and ignores texId, binding once per command buffer is enough
+	void BindTextureDescriptors(VkCommandBuffer commandBuffer, uint32_t currentImage, int texId);
 
 	//  Choose functions
 
@@ -151,8 +207,8 @@ private:
 	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
     
 	// Create functions
-	VkImage CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceMemory* imageMemory);
-	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+	VkImage CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propertyFlags, DeviceAllocation* imageMemory, uint32_t arrayLayers = 1, uint32_t mipLevels = 1);
+	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t layerCount = 1, uint32_t mipLevels = 1);
 	void CreateRenderPass();
 	void CreateGraphicsPipeline();
 	VkShaderModule CreateShaderModule(const std::vector<char>& code);
@@ -164,18 +220,76 @@ private:
 	void CreateDescriptorPool();
 	void CreateDescriptorSets();
 
-	int CreateTextureImage(std::string fileName);
+	int CreateTextureImage(const stbi_uc* imageData, uint32_t width, uint32_t height, TexturePackFormat format, uint32_t mipLevels);
 	void CreateTextureSampler();
-	int CreateTextureDescriptor(VkImageView textureImage);
+	VkDescriptorSet CreateTextureDescriptor();
+	// Points the descriptor of texId at textureImage, no pending command buffer may use it
+	void WriteTextureDescriptor(int texId, VkImageView textureImage);
 
 
 	void UpdateUniformBuffer(uint32_t imageIndex);
 
 	// Assets
 	VkSampler sampler;
-	std::vector<VkImage> textureImages;
-	std::vector<VkDeviceMemory> textureImageMemory;
-	std::vector<VkImageView> textureImageViews;
+	// Everything about one texture, texId indexes textures. Slots are never reused, so ids stay valid for good
+	struct TextureRecord
+	{
+		VkImage image = VK_NULL_HANDLE; // VK_NULL_HANDLE while loading or evicted
+		DeviceAllocation memory;
+		VkImageView view = VK_NULL_HANDLE;
+		VkDescriptorSet descriptor = VK_NULL_HANDLE; // VK_NULL_HANDLE in bindless mode
+		TextureInfo info = {};
+	};
+	std::vector<TextureRecord> textures;
+	TextureRegistry textureRegistry; // file name -> texId, content hash -> texId and layer
+
+	// Adds the record with a descriptor (own set or bindless array element) showing descriptorView
+	int AddTexture(const TextureRecord& texture, VkImageView descriptorView);
+	bool textureCompressionBC = false; // textureCompressionBC feature enabled on the device
+
+	// Residency, evicted textures keep their id and descriptor set, only the image goes away
+	std::unique_ptr<TextureResidency> textureResidency;
+	int placeholderTexture = -1;
+
+	// Streamed back in, drawn (and resident) once the upload submit has finished
+	struct RestoringTexture
+	{
+		int texId;
+		size_t submit;
+	};
+	std::vector<RestoringTexture> restoringTextures;
+
+	void TextureUploaded(int texId);
+	void UpdateTextureResidency();
+	void EnforceTextureBudget();
+	void RestoreTexture(const StreamedTexture& streamed);
+	int ResolveTexture(int texId, uint64_t frame);
+
+	// Errors the renderer recovers from, same output as the ones Init fails on
+	static void ReportError(const std::string& message);
+
+	// CreateTextureAsync handles until their upload finished, submit is 0 while the file is still being decoded
+	struct LoadingTexture
+	{
+		std::string fileName;
+		size_t submit = 0;
+	};
+	std::unique_ptr<AsyncTextureLoader> asyncTextureLoader;
+	std::unordered_map<int, LoadingTexture> loadingTextures;
+
+	void UpdateAsyncTextures();
+
+	// Evicted images wait here until the upload submits that may still copy into them are done
+	struct RetiredTexture
+	{
+		VkImage image;
+		DeviceAllocation memory;
+		VkImageView view;
+		size_t submit;
+	};
+	std::vector<RetiredTexture> retiredTextures;
+
+	void DestroyRetiredTextures();
 
 	// PIPELINE
 	VkPipelineLayout pipelineLayout;
@@ -184,9 +298,7 @@ private:
 	std::vector<VkSemaphore> imageAvailable;
 	std::vector<VkSemaphore> renderFinished;
 	std::vector<VkFence> drawFences;
-
-	// Loader function
-	stbi_uc* LoadTextureFile(std::string fileName, int* width, int* height, VkDeviceSize* imageSize);
+	std::vector<VkFence> imageFences; // fence of the frame that last drew each swapchain image, VK_NULL_HANDLE before the first
 
 	std::mt19937 mt;
 	std::uniform_real_distribution<float> distribution;
@@ -194,6 +306,51 @@ private:
 	ImGui_ImplVulkanH_Window* wd;
 public:
 	int CreateTexture(std::string fileName);
+	// Returns right away, the handle draws with the placeholder while the file is decoded on a background thread
+	// and switches to the real texture once its upload has finished on the GPU (checked at the start of every frame)
+	// A file that fails to load is reported and forgotten, its handle stays on the placeholder and asking again retries
+	int CreateTextureAsync(const std::string& fileName);
+	bool IsTextureLoading(int texId) const { return loadingTextures.count(texId) != 0; }
+	// Upload already decoded RGBA pixels, caller keeps ownership of imageData
+	int CreateTexture(const std::string& fileName, const stbi_uc* imageData, int width, int height, VkDeviceSize imageSize);
+	// Same for a texture pack payload, compressed formats carry mipLevels levels back to back
+	int CreateTexture(const std::string& fileName, const stbi_uc* data, uint32_t width, uint32_t height, TexturePackFormat format, uint32_t mipLevels);
+	// Compressed formats the device can't sample are decoded to RGBA8 on upload
+	bool IsTextureFormatSupported(TexturePackFormat format) const;
+	void ReserveTextures(size_t count);
+
+	// Texture arrays: create all layers up front, fill them in any order, then make them shader readable
+	// Layers are passed in the given format, mipLevels is how many levels every compressed layer carries
+	int BeginTextureArray(uint32_t width, uint32_t height, uint32_t layerCount, TexturePackFormat format = TexturePackFormat::RGBA8, uint32_t mipLevels = 1);
+	void UploadTextureArrayLayers(int texId, uint32_t firstLayer, uint32_t layerCount, const stbi_uc* const* layers);
+	// Layer upload in two steps for decoders writing straight into staging: Reserve hands out width * height * 4 bytes
+	// of mapped memory (RGBA8, rows tightly packed), Commit uploads it. False for arrays that can't take RGBA8 as is
+	// (block compressed, mips box filtered on the CPU) or when staging is short, upload from memory then
+	bool ReserveTextureLayer(int texId, UploadBatch::ImageWrite* write);
+	void CommitTextureLayer(int texId, uint32_t layer, const UploadBatch::ImageWrite& write);
+	void CancelTextureLayer(const UploadBatch::ImageWrite& write);
+	void EndTextureArray(int texId);
+	uint32_t GetMaxTextureArrayLayers();
+
+	// Overwrites a rectangle of a finished RGBA8 texture, data rows are rowPitch bytes apart (0 = width * 4)
+	// Only the rectangle is staged, the copy waits on the GPU for frames still sampling the texture, not on the CPU
+	// Blitted mips are regenerated where the rectangle reaches, on its layer only. CPU made ones can't be (level 0 isn't kept), those textures throw. The texture is never evicted afterwards
+	// Textures dedupe gave to more than one frame throw as well, load those frames with USE_TEXTURE_DEDUPE off to update them
+	void UpdateTextureRegion(int texId, int32_t x, int32_t y, uint32_t width, uint32_t height, const void* data, size_t rowPitch = 0, uint32_t layer = 0);
+
+	// Where to read a texture layer again after eviction, textures without one are never evicted
+	void SetTextureSource(int texId, uint32_t layer, TextureLayerSource source);
+	// Drawn in place of evicted textures until they are streamed back
+	void SetPlaceholderTexture(int texId);
+	void SetTextureBudget(VkDeviceSize budget);
+	const TextureResidency* GetTextureResidency() const { return textureResidency.get(); }
+
+	// Texture and mesh uploads between Begin/End of this batch share one submit
+	UploadBatch& GetUploadBatch() { return *uploadBatch; }
+
+	// Loader function, touches no renderer state so it is safe to call from decode threads
+	static stbi_uc* LoadTextureFile(std::string fileName, int* width, int* height, VkDeviceSize* imageSize);
+
 	VulkanRenderer();
 	virtual ~VulkanRenderer();
 	int Init(GLFWwindow* newWindow);
@@ -203,7 +360,9 @@ public:
 	void InitForVulkan();
 	VkDevice GetLogicalDevice() { return mainDevice.logicalDevice; }
 	VkQueue GetGraphicsQueue() { return graphicsQueue; };
-	inline long long unsigned int GetDeviceMemory() const { return memoryUsed; }
-	static std::unordered_map<std::string, int> imagesID;
+	DeviceAllocatorStats GetMemoryStats() const { return deviceAllocator->GetStats(); }
+	// CPU time RecordCommands took last frame
+	float GetRecordMilliseconds() const { return recordMilliseconds; }
+	size_t GetRecordingThreads() const { return secondaryRecorder ? secondaryRecorder->GetThreadCount() : 0; }
 };
 
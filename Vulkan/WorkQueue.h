@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Bounded queue used to hand work between loader threads
+// Push blocks while the queue is full (capacity 0 = unbounded)
+// Pop blocks while the queue is empty, returns false once closed and drained
+template <typename T>
+class WorkQueue
+{
+public:
+	explicit WorkQueue(size_t capacity = 0) : m_capacity(capacity) {}
+
+	WorkQueue(const WorkQueue&) = delete;
+	WorkQueue& operator=(const WorkQueue&) = delete;
+
+	void Push(T item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notFull.wait(lock, [this] { return m_capacity == 0 || m_items.size() < m_capacity || m_closed; });
+		m_items.push_back(std::move(item));
+		lock.unlock();
+		m_notEmpty.notify_one();
+	}
+
+	bool Pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notEmpty.wait(lock, [this] { return !m_items.empty() || m_closed; });
+		if (m_items.empty())
+			return false;
+
+		item = std::move(m_items.front());
+		m_items.pop_front();
+		lock.unlock();
+		m_notFull.notify_one();
+		return true;
+	}
+
+	// Non blocking pop, returns false if nothing is ready
+	bool TryPop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_items.empty())
+			return false;
+
+		item = std::move(m_items.front());
+		m_items.pop_front();
+		lock.unlock();
+		m_notFull.notify_one();
+		return true;
+	}
+
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closed = true;
+		}
+		m_notEmpty.notify_all();
+		m_notFull.notify_all();
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_notEmpty;
+	std::condition_variable m_notFull;
+	std::deque<T> m_items;
+	size_t m_capacity;
+	bool m_closed = false;
+};